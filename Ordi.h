@@ -8,6 +8,7 @@
 #include <bitcoincore_rpc.h>
 #include <log.h>
 #include <leveldb/db.h>  
+#include <leveldb/cache.h>
 #include <leveldb/write_batch.h> // leveldb::WriteBatch
 #include <thiserror.h>
 #include <vector>
@@ -23,10 +24,23 @@
 #include "updater.h"
 #include "block_updater.h"
 #include "ordi_error.h"
+#include "content_store.h"
+#include "outpoint_filter.h"
+#include "arena.h"
+#include "memory_governor.h"
+#include "snapshot.h"
+#include "interner.h"
+#include "mempool.h"
+#include "state_digest.h"
+#include "bitcoin/value_skim.h"
+#include "spent_resolver.h"
+#include "history.h"
+#include "kill_point.h"
 #include <evmc/evmc.h>
 #include <evmc/helpers.h>
 #include <evmc/instructions.h>
 #include <algorithm>
+#include <unordered_set>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -39,6 +53,13 @@ const std::string ORDI_OUTPUT_VALUE = "output_value";
 const std::string ORDI_ID_TO_INSCRIPTION = "id_inscription";
 const std::string ORDI_INSCRIPTION_TO_OUTPUT = "inscription_output";
 const std::string ORDI_OUTPUT_TO_INSCRIPTION = "output_inscription";
+const std::string ORDI_CONTENT = "content";
+const std::string ORDI_CONTENT_INDEX = "content_index";
+const std::string ORDI_DICTIONARY = "dictionary";
+const std::string ORDI_HISTORY = "history";
+const std::string ORDI_BLOCK_LOCATIONS = "block_locations.dat";
+// Key in `status` holding the last fully committed height.
+const std::string STATUS_HEIGHT = "height";
 
 class OrdiError : public std::exception {
 public:
@@ -58,13 +79,35 @@ public:
     std::string btc_rpc_host;
     std::string btc_rpc_user;
     std::string btc_rpc_pass;
+    // "leveldb" reads Core's blocks/index, "blk" scans blk*.dat directly.
+    std::string btc_index_source;
+    // "bitcoin", "testnet3" or "signet"; selects the block magic and decoder.
+    std::string btc_network;
+    // When set, the tables are loaded from this snapshot before indexing resumes.
+    std::string snapshot_import;
+    // When set, a snapshot is written here once indexing has caught up.
+    std::string snapshot_export;
+    // Follow the mempool for pending inscriptions and transfers once caught up.
+    bool follow_mempool;
+    // Return from start() once the local blk files are indexed instead of
+    // following the node; used by the recovery benchmark.
+    bool exit_at_tip;
+    // Total RSS budget in bytes; 0 means half of physical memory.
+    uint64_t memory_budget;
 
     Options() :
         btc_data_dir(std::getenv("btc_data_dir") ? std::getenv("btc_data_dir") : ""),
         ordi_data_dir(std::getenv("ordi_data_dir") ? std::getenv("ordi_data_dir") : ""),
         btc_rpc_host(std::getenv("btc_rpc_host") ? std::getenv("btc_rpc_host") : ""),
         btc_rpc_user(std::getenv("btc_rpc_user") ? std::getenv("btc_rpc_user") : ""),
-        btc_rpc_pass(std::getenv("btc_rpc_pass") ? std::getenv("btc_rpc_pass") : "") {}
+        btc_rpc_pass(std::getenv("btc_rpc_pass") ? std::getenv("btc_rpc_pass") : ""),
+        btc_index_source(std::getenv("btc_index_source") ? std::getenv("btc_index_source") : "leveldb"),
+        btc_network(std::getenv("btc_network") ? std::getenv("btc_network") : "bitcoin"),
+        snapshot_import(std::getenv("ordi_snapshot_import") ? std::getenv("ordi_snapshot_import") : ""),
+        snapshot_export(std::getenv("ordi_snapshot_export") ? std::getenv("ordi_snapshot_export") : ""),
+        follow_mempool(std::getenv("ordi_follow_mempool") && std::string(std::getenv("ordi_follow_mempool")) == "1"),
+        exit_at_tip(std::getenv("ordi_exit_at_tip") && std::string(std::getenv("ordi_exit_at_tip")) == "1"),
+        memory_budget(std::getenv("ordi_memory_budget") ? std::stoull(std::getenv("ordi_memory_budget")) : 0) {}
 };
 
 class Ordi {
@@ -75,44 +118,225 @@ public:
     DB id_inscription;
     DB inscription_output;
     DB output_inscription;
+    DB dictionary;
+    DB history;
+    DB content_index;
+    Interner address_ids{'a'};
+    Interner ticker_ids{'t'};
+    StateDigest state_digest;
+    SpentResolver spent_resolver;
+    HistoryIndex history_index;
+    ContentStore content_store;
+    OutpointFilter inscribed_outpoints;
     Index index;
+    BlockArena block_arena;
+    MemoryGovernor memory_governor;
+    leveldb::Cache* block_cache = nullptr;
+    BoundedCache<std::string, uint64_t> output_value_cache;
+    BoundedCache<std::string, std::string> inscription_cache;
     std::vector<InscribeUpdater> inscribe_updaters;
     std::vector<TransferUpdater> transfer_updaters;
+    std::string snapshot_export_path;
+    bool follow_mempool = false;
+    bool exit_at_tip = false;
+    // Separate connection so the follower thread never shares btc_rpc_client.
+    Client mempool_rpc_client;
+    std::unique_ptr<MempoolFollower<Client>> mempool;
+    std::thread mempool_thread;
+    std::atomic<bool> stopping{false};
 
     void close() {
+        stopping = true;
+        if (mempool_thread.joinable()) {
+            mempool_thread.join();
+        }
         status.close();
         output_value.close();
         id_inscription.close();
         inscription_output.close();
         output_inscription.close();
+        dictionary.close();
+        history.close();
+        content_store.close();
+        content_index.close();
+        delete block_cache;
+        block_cache = nullptr;
     }
 
     void start() {
         int next_height = index.max_height + 1;
-        for (int height = FIRST_INSCRIPTION_HEIGHT; height < next_height; height++) {
-            Block block = index.catch_block(height);
-            BlockUpdater block_updater(height, block, btc_rpc_client, status, output_value, id_inscription, inscription_output, output_inscription, inscribe_updaters, transfer_updaters);
-            block_updater.index_transactions();
+        int first_height = std::max(FIRST_INSCRIPTION_HEIGHT, committed_height() + 1);
+        for (int height = first_height; height < next_height; height++) {
+            {
+                Block& block = index.catch_block(height, block_arena);
+                spent_resolver.resolve(block, output_value, output_inscription, output_value_cache, inscribed_outpoints, block_arena);
+                BlockUpdater block_updater(height, block, btc_rpc_client, status, output_value, id_inscription, inscription_output, output_inscription, content_store, dictionary, address_ids, ticker_ids, state_digest, spent_resolver, history, history_index, block_arena, output_value_cache, inscription_cache, inscribe_updaters, transfer_updaters);
+                block_updater.index_transactions();
+                commit_block(height, block);
+            }
+            ORDI_KILL_POINT("block.after_commit");
+            rebalance_memory();
+            spent_resolver.clear();
+            block_arena.reset();
+        }
+        std::cout << "Caught up to height " << committed_height() << ", memory:" << std::endl;
+        memory_governor.report();
+        if (!snapshot_export_path.empty()) {
+            export_snapshot(snapshot_export_path);
+        }
+        if (exit_at_tip) {
+            return;
+        }
+        next_height = std::max(next_height, committed_height() + 1);
+        if (follow_mempool) {
+            // Only thread-safe DB lookups are used here; the outpoint filter
+            // and the caches are owned by the indexing thread.
+            mempool = std::make_unique<MempoolFollower<Client>>(mempool_rpc_client, [this](const std::string& outpoint) {
+                return output_inscription.get(outpoint).has_value();
+            }, [this](const std::string& outpoint) -> std::optional<uint64_t> {
+                std::optional<std::vector<uint8_t>> value = output_value.get(outpoint);
+                if (!value.has_value() || value->size() != sizeof(uint64_t)) {
+                    return std::nullopt;
+                }
+                uint64_t sats;
+                std::memcpy(&sats, value->data(), sizeof(uint64_t));
+                return sats;
+            });
+            mempool_thread = std::thread([this]() { mempool->run(stopping); });
         }
         while (true) {
             try {
-                std::string block_hash = btc_rpc_client.get_block_hash(next_height);
-                BlockUpdater block_updater(next_height, btc_rpc_client.get_block(block_hash), btc_rpc_client, status, output_value, id_inscription, inscription_output, output_inscription, inscribe_updaters, transfer_updaters);
-                block_updater.index_transactions();
+                {
+                    std::string block_hash = btc_rpc_client.get_block_hash(next_height);
+                    auto block = btc_rpc_client.get_block(block_hash);
+                    spent_resolver.resolve(block, output_value, output_inscription, output_value_cache, inscribed_outpoints, block_arena);
+                    BlockUpdater block_updater(next_height, block, btc_rpc_client, status, output_value, id_inscription, inscription_output, output_inscription, content_store, dictionary, address_ids, ticker_ids, state_digest, spent_resolver, history, history_index, block_arena, output_value_cache, inscription_cache, inscribe_updaters, transfer_updaters);
+                    block_updater.index_transactions();
+                    commit_block(next_height, block);
+                    if (mempool) {
+                        mempool->on_block(block);
+                    }
+                }
+                rebalance_memory();
+                spent_resolver.clear();
+                block_arena.reset();
                 next_height++;
             } catch (...) {
+                // Drop whatever the failed block folded in; the retry starts
+                // from the last committed height.
+                load_state_digest();
+                history_index.clear_staged();
+                next_height = committed_height() + 1;
+                spent_resolver.clear();
+                block_arena.reset();
                 std::this_thread::sleep_for(std::chrono::seconds(10));
             }
         }
     }
 
-    void index_output_value() {
-        for (int height = 0; height < FIRST_INSCRIPTION_HEIGHT; height++) {
-            Block block = index.catch_block(height);
-            for (int tx_index = 0; tx_index < block.txs.size(); tx_index++) {
-                index_output_value_in_transaction(block.txs[tx_index]);
+    // Marks `height` as committed once BlockUpdater has written the block's
+    // tables. Content bodies are made durable first, so a committed height
+    // never references content that recovery could truncate away. The
+    // inscribed outpoint filter only moves forward once the height is in.
+    template<typename B>
+    void commit_block(int height, const B& block) {
+        OutpointFilterChanges changes = inscribed_outpoint_changes(block);
+        content_store.commit(content_index);
+        ORDI_KILL_POINT("block.before_status");
+        WriteBatch wb;
+        state_digest.stage(wb, height);
+        wb.put(STATUS_HEIGHT, std::to_string(height));
+        status.write(wb, false);
+        inscribed_outpoints.apply(changes);
+    }
+
+    // Spent outpoints that held inscriptions leave the filter. Inscriptions
+    // can only land on outputs of a tx that reveals one or spends one
+    // (directly or through an earlier carrier in the block), or on the
+    // coinbase when one goes to fees; those outputs are checked against
+    // output_inscription, which BlockUpdater has already written.
+    template<typename B>
+    OutpointFilterChanges inscribed_outpoint_changes(const B& block) {
+        OutpointFilterChanges changes;
+        std::unordered_set<std::string> carriers;
+        std::vector<std::string> candidates;
+        for (size_t tx_index = 0; tx_index < block.txs.size(); tx_index++) {
+            const auto& tx = block.txs[tx_index];
+            bool carries = !inscriptions_of(tx).empty();
+            for (size_t input_index = 0; input_index < tx_inputs(tx).size(); input_index++) {
+                const ResolvedInput& input = spent_resolver.input(tx_index, input_index);
+                if (input.inscriptions.has_value()) {
+                    changes.erased.push_back(std::string(input.outpoint));
+                    carries = true;
+                } else if (input.in_block && carriers.count(std::string(input.outpoint.substr(0, input.outpoint.find(':')))) > 0) {
+                    carries = true;
+                }
+            }
+            if (carries) {
+                std::string txid = tx.hash.to_string();
+                carriers.insert(txid);
+                for (size_t vout = 0; vout < tx_output_count(tx); vout++) {
+                    candidates.push_back(txid + ":" + std::to_string(vout));
+                }
+            }
+        }
+        if (!candidates.empty()) {
+            const auto& coinbase = block.txs.front();
+            std::string txid = coinbase.hash.to_string();
+            if (carriers.count(txid) == 0) {
+                for (size_t vout = 0; vout < tx_output_count(coinbase); vout++) {
+                    candidates.push_back(txid + ":" + std::to_string(vout));
+                }
+            }
+        }
+
+        std::sort(candidates.begin(), candidates.end());
+        auto iter = output_inscription.new_iter();
+        std::vector<uint8_t> key, value;
+        for (const std::string& outpoint : candidates) {
+            iter.seek(outpoint);
+            if (iter.current(key, value) && key.size() == outpoint.size() && std::equal(key.begin(), key.end(), outpoint.begin())) {
+                changes.inserted.push_back(outpoint);
             }
         }
+        return changes;
+    }
+
+    // Only txids, output values and spent outpoints matter below the first
+    // inscription height, so blocks are skimmed rather than fully decoded.
+    void index_output_value() {
+        std::vector<uint8_t> raw_block;
+        ValueSkim skim;
+        for (int height = committed_height() + 1; height < FIRST_INSCRIPTION_HEIGHT; height++) {
+            index.catch_raw_block(height, raw_block);
+            ValueSkimmer skimmer(raw_block.data(), raw_block.size());
+            visit_coin(index.coin(), [&](auto c) { skimmer.skim<decltype(c)>(skim); });
+            index_output_value_in_skim(skim);
+            ORDI_KILL_POINT("output_value.between_writes");
+            WriteBatch wb;
+            state_digest.stage(wb, height);
+            wb.put(STATUS_HEIGHT, std::to_string(height));
+            status.write(wb, false);
+            ORDI_KILL_POINT("output_value.after_commit");
+        }
+    }
+
+    void index_output_value_in_skim(const ValueSkim& skim) {
+        WriteBatch wb;
+        // Outputs spent later in the same block are put before they are deleted.
+        for (const SkimOutput& output : skim.outputs) {
+            std::string k = txid_to_string(output.txid) + ":" + std::to_string(output.vout);
+            std::string v(reinterpret_cast<const char*>(&output.value), sizeof(uint64_t));
+            wb.put(k, v);
+            state_digest.put(ORDI_OUTPUT_VALUE, k, v);
+        }
+        for (const SkimSpend& spend : skim.spends) {
+            std::string k = txid_to_string(spend.txid) + ":" + std::to_string(spend.vout);
+            wb.delete(k.c_str());
+            state_digest.del(ORDI_OUTPUT_VALUE, k);
+            output_value_cache.erase(k);
+        }
+        output_value.write(wb, false);
     }
 
     Ordi(const Options& options) {
@@ -121,42 +345,149 @@ public:
             fs::create_directory(ordi_data_dir);
         }
 
-        index = Index(fs::path(options.btc_data_dir));
+        Coin coin = coin_from_name(options.btc_network);
+        if (options.btc_index_source == "blk") {
+            index = Index(options.btc_data_dir, coin, (ordi_data_dir / ORDI_BLOCK_LOCATIONS).string());
+        } else {
+            index = Index(fs::path(options.btc_data_dir), coin);
+        }
+
+        memory_governor.set_budget(options.memory_budget);
+        block_cache = leveldb::NewLRUCache(memory_governor.block_cache_size());
+        memory_governor.reserve("leveldb_block_cache", memory_governor.block_cache_size());
+        std::vector<std::pair<std::string, DB*>> tables = disk_tables();
+        size_t memtable_size = memory_governor.memtable_size(tables.size());
+        // An active and a full immutable memtable can coexist per table.
+        memory_governor.reserve("leveldb_memtables", 2 * memtable_size * tables.size());
 
         leveldb::Options leveldb_options;
         leveldb_options.max_file_size = 2 << 25;
+        leveldb_options.block_cache = block_cache;
+        leveldb_options.write_buffer_size = memtable_size;
+
+        for (auto& table : tables) {
+            *table.second = rusty_leveldb::DB::open(ordi_data_dir / table.first, leveldb_options);
+        }
+        if (!options.snapshot_import.empty()) {
+            import_snapshot(options.snapshot_import);
+        }
+        address_ids.load(dictionary);
+        ticker_ids.load(dictionary);
+        load_state_digest();
+        // After any import, so the store checks its segments against the
+        // imported content index tail instead of rescanning them.
+        content_store.open(ordi_data_dir / ORDI_CONTENT, content_index);
+        inscribed_outpoints.rebuild(inscription_output);
+        check_output_inscription();
+        snapshot_export_path = options.snapshot_export;
+        follow_mempool = options.follow_mempool;
+        exit_at_tip = options.exit_at_tip;
 
-        status = rusty_leveldb::DB::open(ordi_data_dir / ORDI_STATUS, leveldb_options);
-        output_value = rusty_leveldb::DB::open(ordi_data_dir / ORDI_OUTPUT_VALUE, leveldb_options);
-        id_inscription = rusty_leveldb::DB::open(ordi_data_dir / ORDI_ID_TO_INSCRIPTION, leveldb_options);
-        inscription_output = rusty_leveldb::DB::open(ordi_data_dir / ORDI_INSCRIPTION_TO_OUTPUT, leveldb_options);
-        output_inscription = rusty_leveldb::DB::open(ordi_data_dir / ORDI_OUTPUT_TO_INSCRIPTION, rusty_leveldb::in_memory());
+        memory_governor.add("output_value_cache", &output_value_cache, 16 << 20, 2.0);
+        memory_governor.add("inscription_cache", &inscription_cache, 8 << 20, 1.0);
+        rebalance_memory();
 
         btc_rpc_client = bitcoincore_rpc::Client(options.btc_rpc_host, bitcoincore_rpc::Auth::UserPass(options.btc_rpc_user, options.btc_rpc_pass));
+        if (follow_mempool) {
+            mempool_rpc_client = bitcoincore_rpc::Client(options.btc_rpc_host, bitcoincore_rpc::Auth::UserPass(options.btc_rpc_user, options.btc_rpc_pass));
+        }
     }
-    void when_inscribe(InscribeUpdater f) {
-        inscribe_updaters.push_back(f);
+    // -1 when nothing has been committed yet.
+    int committed_height() {
+        std::optional<std::vector<uint8_t>> height = status.get(STATUS_HEIGHT);
+        if (!height.has_value()) {
+            return -1;
+        }
+        return std::stoi(std::string(height->begin(), height->end()));
     }
 
-    void when_transfer(TransferUpdater f) {
-        transfer_updaters.push_back(f);
+    // Hex digest of all changes committed up to `height`; empty if unknown.
+    // Replicas agree at a height iff these match.
+    std::string state_digest_at(uint64_t height) {
+        std::optional<StateDigest> digest = StateDigest::at(status, height);
+        return digest.has_value() ? digest->to_hex() : "";
     }
-    
-    void index_output_value_in_transaction(Tx tx) {
-        WriteBatch wb;
-        for (int output_index = 0; output_index < tx.value.outputs.size(); output_index++) {
-            std::string k = tx.hash.to_string() + ":" + std::to_string(output_index);
-            wb.put(k.c_str(), reinterpret_cast<const char*>(&tx.value.outputs[output_index].out.value));
+
+    // Inscription and BRC-20 activity of the address paying to `script_pubkey`
+    // between two heights, inclusive.
+    std::vector<HistoryEvent> address_history(const std::string& script_pubkey, uint32_t from_height, uint32_t to_height) {
+        uint32_t address_id;
+        if (!address_ids.find(script_pubkey, address_id)) {
+            return {};
         }
+        return history_index.query(history, address_id, from_height, to_height);
+    }
 
-        for (Input input : tx.value.inputs) {
-            if (input.outpoint.is_null()) {
-                continue;
-            }
-            std::string k = input.outpoint.txid.to_string() + ":" + std::to_string(input.outpoint.index);
-            wb.delete(k.c_str());
+    // Tables opened on disk; each gets a memtable out of the memory budget.
+    std::vector<std::pair<std::string, DB*>> disk_tables() {
+        return {
+            {ORDI_STATUS, &status},
+            {ORDI_OUTPUT_VALUE, &output_value},
+            {ORDI_ID_TO_INSCRIPTION, &id_inscription},
+            {ORDI_INSCRIPTION_TO_OUTPUT, &inscription_output},
+            {ORDI_OUTPUT_TO_INSCRIPTION, &output_inscription},
+            {ORDI_DICTIONARY, &dictionary},
+            {ORDI_HISTORY, &history},
+            {ORDI_CONTENT_INDEX, &content_index},
+        };
+    }
+
+    std::vector<std::pair<std::string, DB*>> snapshot_tables() {
+        return disk_tables();
+    }
+
+    // Must run between blocks on the indexing thread so every table is at the
+    // same committed height. Content segments are append-only and committed
+    // with every block, so they can be copied next to the snapshot at any
+    // later time.
+    void export_snapshot(const std::string& path) {
+        content_store.commit(content_index);
+        ::export_snapshot(path, committed_height(), snapshot_tables());
+    }
+
+    // Runs in the constructor before anything is loaded from the tables. The
+    // snapshot's content segments must already be in ordi_data_dir/content.
+    void import_snapshot(const std::string& path) {
+        if (committed_height() >= 0) {
+            throw OrdiError("Refusing to import a snapshot into a non-empty ordi_data_dir.");
         }
+        ::import_snapshot(path, snapshot_tables());
+    }
 
-        output_value.write(wb, false);
+    // output_inscription used to live only in memory, so a data dir written
+    // before it was persisted has inscriptions but no outpoint -> inscription
+    // entries. Resuming from such a dir would silently drop their transfers.
+    void check_output_inscription() {
+        if (committed_height() < 0) {
+            return;
+        }
+        std::vector<uint8_t> key, value;
+        auto inscriptions = inscription_output.new_iter();
+        auto outpoints = output_inscription.new_iter();
+        if (inscriptions.advance() && inscriptions.current(key, value) && !(outpoints.advance() && outpoints.current(key, value))) {
+            throw OrdiError("output_inscription is empty but inscriptions exist; reindex this ordi_data_dir.");
+        }
+    }
+
+    void load_state_digest() {
+        int height = committed_height();
+        std::optional<StateDigest> digest = height >= 0 ? StateDigest::at(status, height) : std::nullopt;
+        state_digest = digest.has_value() ? *digest : StateDigest();
+    }
+
+    void rebalance_memory() {
+        memory_governor.reserve("index", index.memory_usage());
+        memory_governor.reserve("inscribed_outpoints", inscribed_outpoints.memory_usage());
+        memory_governor.reserve("block_arena", block_arena.capacity());
+        memory_governor.reserve("interned_ids", address_ids.memory_usage() + ticker_ids.memory_usage());
+        memory_governor.rebalance();
+    }
+
+    void when_inscribe(InscribeUpdater f) {
+        inscribe_updaters.push_back(f);
+    }
+
+    void when_transfer(TransferUpdater f) {
+        transfer_updaters.push_back(f);
     }
 };
\ No newline at end of file
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <memory_resource>
+#include <optional>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+const size_t DEFAULT_BLOCK_ARENA_SIZE = 64 << 20;
+
+// Forwards to an upstream resource and remembers how much was requested, so
+// the arena can tell how far a block spilled past its preallocated buffer.
+class CountingResource : public std::pmr::memory_resource {
+public:
+    CountingResource(std::pmr::memory_resource* upstream) : upstream(upstream) {}
+    size_t allocated = 0;
+
+private:
+    std::pmr::memory_resource* upstream;
+
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        allocated += bytes;
+        return upstream->allocate(bytes, alignment);
+    }
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+        upstream->deallocate(p, bytes, alignment);
+    }
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+};
+
+// Monotonic arena backing a decoded block and BlockUpdater's scratch data.
+// Objects created with make() are never destroyed individually: reset() drops
+// everything at once, so tearing down a block is O(1) regardless of how many
+// transactions, scripts and witness items it held. The buffer is reused
+// across blocks and grows to the high-water mark when a block overflows it.
+class BlockArena {
+public:
+    BlockArena(size_t initial_size = DEFAULT_BLOCK_ARENA_SIZE) : buffer(initial_size), overflow(std::pmr::new_delete_resource()) {
+        resource.emplace(buffer.data(), buffer.size(), &overflow);
+    }
+    BlockArena(const BlockArena&) = delete;
+    BlockArena& operator=(const BlockArena&) = delete;
+
+    std::pmr::memory_resource* get() {
+        return &*resource;
+    }
+
+    // Only for types whose memory lives entirely in this arena (pmr containers
+    // built with get()); their destructors are skipped on reset().
+    template<typename T, typename... Args>
+    T& make(Args&&... args) {
+        void* p = resource->allocate(sizeof(T), alignof(T));
+        return *new (p) T(std::forward<Args>(args)...);
+    }
+
+    void reset() {
+        size_t spilled = overflow.allocated;
+        resource.reset();
+        overflow.allocated = 0;
+        if (spilled > 0) {
+            buffer = std::vector<uint8_t>(buffer.size() + spilled + spilled / 4);
+        }
+        resource.emplace(buffer.data(), buffer.size(), &overflow);
+    }
+
+    size_t capacity() const {
+        return buffer.size();
+    }
+
+private:
+    std::vector<uint8_t> buffer;
+    CountingResource overflow;
+    std::optional<std::pmr::monotonic_buffer_resource> resource;
+};
@@ -1,9 +1,14 @@
+#pragma once
+
 #include <iostream>
 #include <vector>
 #include <array>
 #include <cstdint>
 #include <algorithm>
 #include <stdexcept>
+#include <string>
+#include <memory_resource>
+#include <bitcoin/system.hpp>
 
 namespace anyhow {
     class Error : public std::exception {
@@ -48,6 +53,23 @@ namespace sha256d {
         static Hash fromByteArray(const std::array<uint8_t, 32>& data) {
             return Hash(data);
         }
+        const std::array<uint8_t, 32>& bytes() const {
+            return data;
+        }
+        bool is_zero() const {
+            return data == std::array<uint8_t, 32>{};
+        }
+        // Display order (reversed) hex, like bitcoind and the RPC types.
+        std::string to_string() const {
+            static const char* digits = "0123456789abcdef";
+            std::string hex(64, '0');
+            for (size_t i = 0; i < 32; i++) {
+                uint8_t b = data[31 - i];
+                hex[2 * i] = digits[b >> 4];
+                hex[2 * i + 1] = digits[b & 0xf];
+            }
+            return hex;
+        }
     private:
         std::array<uint8_t, 32> data;
     };
@@ -56,20 +78,23 @@ namespace sha256d {
 class VarUint {
 public:
     VarUint(uint64_t value) : value(value) {}
-    static VarUint readFrom(BlockchainRead& reader) {
-        // implementation
+    template<typename R>
+    static VarUint readFrom(R& reader) {
+        uint8_t first = reader.readU8();
+        if (first < 0xfd) {
+            return VarUint(first);
+        }
+        size_t width = first == 0xfd ? 2 : first == 0xfe ? 4 : 8;
+        uint64_t value = 0;
+        for (size_t i = 0; i < width; i++) {
+            value |= static_cast<uint64_t>(reader.readU8()) << (8 * i);
+        }
+        return VarUint(value);
     }
 private:
     uint64_t value;
 };
 
-class CoinType {
-public:
-    CoinType(uint32_t auxPowActivationVersion, uint8_t versionId) : auxPowActivationVersion(auxPowActivationVersion), versionId(versionId) {}
-    uint32_t auxPowActivationVersion;
-    uint8_t versionId;
-};
-
 class BlockHeader {
 public:
     BlockHeader(uint32_t version, const sha256d::Hash& prevHash, const sha256d::Hash& merkleRoot, uint32_t timestamp, uint32_t bits, uint32_t nonce) : version(version), prevHash(prevHash), merkleRoot(merkleRoot), timestamp(timestamp), bits(bits), nonce(nonce) {}
@@ -83,22 +108,24 @@ public:
 
 class Block {
 public:
-    Block(uint32_t size, const BlockHeader& header, const AuxPowExtension& auxPowExtension, const VarUint& txCount, const std::vector<RawTx>& txs) : size(size), header(header), auxPowExtension(auxPowExtension), txCount(txCount), txs(txs) {}
+    Block(uint32_t size, const BlockHeader& header, const AuxPowExtension& auxPowExtension, const VarUint& txCount, std::pmr::vector<RawTx> txs) : size(size), header(header), auxPowExtension(auxPowExtension), txCount(txCount), txs(std::move(txs)) {}
     uint32_t size;
     BlockHeader header;
     AuxPowExtension auxPowExtension;
     VarUint txCount;
-    std::vector<RawTx> txs;
+    std::pmr::vector<RawTx> txs;
 };
 
 class RawTx {
 public:
-    RawTx(uint32_t version, const VarUint& inCount, const std::vector<TxInput>& inputs, const VarUint& outCount, const std::vector<TxOutput>& outputs, uint32_t locktime, uint8_t versionId) : version(version), inCount(inCount), inputs(inputs), outCount(outCount), outputs(outputs), locktime(locktime), versionId(versionId) {}
+    RawTx(const sha256d::Hash& hash, uint32_t version, const VarUint& inCount, std::pmr::vector<TxInput> inputs, const VarUint& outCount, std::pmr::vector<TxOutput> outputs, uint32_t locktime, uint8_t versionId) : hash(hash), version(version), inCount(inCount), inputs(std::move(inputs)), outCount(outCount), outputs(std::move(outputs)), locktime(locktime), versionId(versionId) {}
+    // txid, computed by the decoder over the legacy serialization.
+    sha256d::Hash hash;
     uint32_t version;
     VarUint inCount;
-    std::vector<TxInput> inputs;
+    std::pmr::vector<TxInput> inputs;
     VarUint outCount;
-    std::vector<TxOutput> outputs;
+    std::pmr::vector<TxOutput> outputs;
     uint32_t locktime;
     uint8_t versionId;
 };
@@ -108,26 +135,44 @@ public:
     TxOutpoint(const sha256d::Hash& txid, uint32_t index) : txid(txid), index(index) {}
     sha256d::Hash txid;
     uint32_t index;
+    // The coinbase input's outpoint.
+    bool is_null() const {
+        return index == 0xffffffff && txid.is_zero();
+    }
 };
 
 class TxInput {
 public:
-    TxInput(const TxOutpoint& outpoint, const VarUint& scriptLen, const std::vector<uint8_t>& scriptSig, uint32_t seqNo, const std::optional<Witness>& witness) : outpoint(outpoint), scriptLen(scriptLen), scriptSig(scriptSig), seqNo(seqNo), witness(witness) {}
+    TxInput(const TxOutpoint& outpoint, const VarUint& scriptLen, std::pmr::vector<uint8_t> scriptSig, uint32_t seqNo, std::optional<Witness> witness) : outpoint(outpoint), scriptLen(scriptLen), scriptSig(std::move(scriptSig)), seqNo(seqNo), witness(std::move(witness)) {}
     TxOutpoint outpoint;
     VarUint scriptLen;
-    std::vector<uint8_t> scriptSig;
+    std::pmr::vector<uint8_t> scriptSig;
     uint32_t seqNo;
     std::optional<Witness> witness;
 };
 
 class TxOutput {
 public:
-    TxOutput(uint64_t value, const VarUint& scriptLen, const std::vector<uint8_t>& scriptPubkey) : value(value), scriptLen(scriptLen), scriptPubkey(scriptPubkey) {}
+    TxOutput(uint64_t value, const VarUint& scriptLen, std::pmr::vector<uint8_t> scriptPubkey) : value(value), scriptLen(scriptLen), scriptPubkey(std::move(scriptPubkey)) {}
     uint64_t value;
     VarUint scriptLen;
-    std::vector<uint8_t> scriptPubkey;
+    std::pmr::vector<uint8_t> scriptPubkey;
 };
 
+// Accessors shared with the RPC transaction type, which nests inputs and
+// outputs under `value` (see spent_resolver.h).
+inline const std::pmr::vector<TxInput>& tx_inputs(const RawTx& tx) {
+    return tx.inputs;
+}
+
+inline size_t tx_output_count(const RawTx& tx) {
+    return tx.outputs.size();
+}
+
+inline uint64_t tx_output_value(const RawTx& tx, size_t vout) {
+    return tx.outputs[vout].value;
+}
+
 class MerkleBranch {
 public:
     MerkleBranch(const std::vector<std::array<uint8_t, 32>>& hashes, uint32_t sideMask) : hashes(hashes), sideMask(sideMask) {}
@@ -145,47 +190,42 @@ public:
     BlockHeader parentBlock;
 };
 
-class BlockchainRead {
-public:
-    virtual ~BlockchainRead() {}
-    virtual std::array<uint8_t, 32> read256Hash() = 0;
-    virtual std::vector<uint8_t> readU8Vec(uint32_t count) = 0;
-    virtual Block readBlock(uint32_t size, const CoinType& coin) = 0;
-    virtual BlockHeader readBlockHeader() = 0;
-    virtual std::vector<RawTx> readTxs(uint64_t txCount, uint8_t versionId) = 0;
-    virtual RawTx readTx(uint8_t versionId) = 0;
-    virtual TxOutpoint readTxOutpoint() = 0;
-    virtual std::vector<TxInput> readTxInputs(uint64_t inputCount) = 0;
-    virtual std::vector<TxOutput> readTxOutputs(uint64_t outputCount) = 0;
-    virtual MerkleBranch readMerkleBranch() = 0;
-    virtual AuxPowExtension readAuxPowExtension(uint8_t versionId) = 0;
-};
-
-template<typename R>
-class BlockchainReadImpl : public BlockchainRead {
+// Block decoder for reader R and coin policy C (see bitcoin/mod.h). There is
+// no virtual interface: every method is resolved at compile time so the whole
+// decode loop can be inlined per coin.
+//
+// All containers of the decoded block are allocated from `mr`; pass a
+// BlockArena's resource to make the block's teardown O(1).
+//
+// R must expose position() and bytes(offset) over the serialized block so
+// txids can be hashed from the bytes already read.
+template<typename R, typename C>
+class BlockchainReadImpl {
 public:
-    BlockchainReadImpl(R& reader) : reader(reader) {}
-    std::array<uint8_t, 32> read256Hash() override {
+    BlockchainReadImpl(R& reader, std::pmr::memory_resource* mr = std::pmr::get_default_resource()) : reader(reader), mr(mr) {}
+    std::array<uint8_t, 32> read256Hash() {
         std::array<uint8_t, 32> arr;
-        reader.readExact(arr.data());
+        reader.readExact(arr.data(), arr.size());
         return arr;
     }
-    std::vector<uint8_t> readU8Vec(uint32_t count) override {
-        std::vector<uint8_t> arr(count);
-        reader.readExact(arr.data());
+    std::pmr::vector<uint8_t> readU8Vec(uint32_t count) {
+        std::pmr::vector<uint8_t> arr(count, mr);
+        reader.readExact(arr.data(), arr.size());
         return arr;
     }
-    Block readBlock(uint32_t size, const CoinType& coin) override {
+    Block readBlock(uint32_t size) {
         BlockHeader header = readBlockHeader();
         std::optional<AuxPowExtension> auxPowExtension;
-        if (coin.auxPowActivationVersion && header.version >= *coin.auxPowActivationVersion) {
-            auxPowExtension = readAuxPowExtension(coin.versionId);
+        if constexpr (C::HAS_AUX_POW) {
+            if (header.version >= C::AUX_POW_ACTIVATION_VERSION) {
+                auxPowExtension = readAuxPowExtension();
+            }
         }
         VarUint txCount = VarUint::readFrom(reader);
-        std::vector<RawTx> txs = readTxs(txCount.unwrap().value, coin.versionId);
-        return Block(size, header, auxPowExtension, txCount, txs);
+        std::pmr::vector<RawTx> txs = readTxs(txCount.unwrap().value);
+        return Block(size, header, auxPowExtension, txCount, std::move(txs));
     }
-    BlockHeader readBlockHeader() override {
+    BlockHeader readBlockHeader() {
         uint32_t version = reader.readU32();
         sha256d::Hash prevHash = sha256d::Hash::fromByteArray(read256Hash());
         sha256d::Hash merkleRoot = sha256d::Hash::fromByteArray(read256Hash());
@@ -194,66 +234,87 @@ public:
         uint32_t nonce = reader.readU32();
         return BlockHeader(version, prevHash, merkleRoot, timestamp, bits, nonce);
     }
-    std::vector<RawTx> readTxs(uint64_t txCount, uint8_t versionId) override {
-        std::vector<RawTx> txs;
+    std::pmr::vector<RawTx> readTxs(uint64_t txCount) {
+        std::pmr::vector<RawTx> txs(mr);
+        txs.reserve(txCount);
         for (uint64_t i = 0; i < txCount; i++) {
-            txs.push_back(readTx(versionId));
+            txs.push_back(readTx());
         }
         return txs;
     }
-    RawTx readTx(uint8_t versionId) override {
+    RawTx readTx() {
         uint8_t flags = 0;
+        size_t start = reader.position();
         uint32_t version = reader.readU32();
+        size_t bodyStart = reader.position();
         VarUint inCount = VarUint::readFrom(reader);
         if (inCount.unwrap().value == 0) {
             flags = reader.readU8();
+            bodyStart = reader.position();
             inCount = VarUint::readFrom(reader);
         }
-        std::vector<TxInput> inputs = readTxInputs(inCount.unwrap().value);
+        std::pmr::vector<TxInput> inputs = readTxInputs(inCount.unwrap().value);
         VarUint outCount = VarUint::readFrom(reader);
-        std::vector<TxOutput> outputs = readTxOutputs(outCount.unwrap().value);
+        std::pmr::vector<TxOutput> outputs = readTxOutputs(outCount.unwrap().value);
+        size_t bodyEnd = reader.position();
         if (flags & 1) {
             for (uint64_t witnessIndex = 0; witnessIndex < inCount.unwrap().value; witnessIndex++) {
                 VarUint itemCount = VarUint::readFrom(reader);
-                std::vector<std::vector<uint8_t>> witnesses;
+                std::pmr::vector<std::pmr::vector<uint8_t>> witnesses(mr);
+                witnesses.reserve(itemCount.unwrap().value);
                 for (uint64_t j = 0; j < itemCount.unwrap().value; j++) {
                     VarUint witnessLen = VarUint::readFrom(reader);
-                    std::vector<uint8_t> witness = readU8Vec(witnessLen.unwrap().value);
-                    witnesses.push_back(witness);
+                    witnesses.push_back(readU8Vec(witnessLen.unwrap().value));
                 }
-                inputs[witnessIndex].witness = Witness::fromSlice(witnesses);
+                inputs[witnessIndex].witness = Witness::fromSlice(std::move(witnesses));
             }
         }
+        size_t locktimeStart = reader.position();
         uint32_t locktime = reader.readU32();
-        return RawTx(version, inCount, inputs, outCount, outputs, locktime, versionId);
+        sha256d::Hash hash = sha256d::Hash::fromByteArray(txid(start, bodyStart, bodyEnd, locktimeStart));
+        return RawTx(hash, version, inCount, std::move(inputs), outCount, std::move(outputs), locktime, C::VERSION_ID);
     }
-    TxOutpoint readTxOutpoint() override {
+    // txid commits to the legacy serialization: version, inputs, outputs,
+    // locktime; the segwit marker, flag and witnesses are left out.
+    std::array<uint8_t, 32> txid(size_t start, size_t bodyStart, size_t bodyEnd, size_t locktimeStart) {
+        scratch.clear();
+        scratch.insert(scratch.end(), reader.bytes(start), reader.bytes(start + 4));
+        scratch.insert(scratch.end(), reader.bytes(bodyStart), reader.bytes(bodyEnd));
+        scratch.insert(scratch.end(), reader.bytes(locktimeStart), reader.bytes(locktimeStart + 4));
+        libbitcoin::system::hash_digest digest = libbitcoin::system::sha256_hash(libbitcoin::system::sha256_hash(scratch));
+        std::array<uint8_t, 32> hash;
+        std::copy(digest.begin(), digest.end(), hash.begin());
+        return hash;
+    }
+    TxOutpoint readTxOutpoint() {
         sha256d::Hash txid = sha256d::Hash::fromByteArray(read256Hash());
         uint32_t index = reader.readU32();
         return TxOutpoint(txid, index);
     }
-    std::vector<TxInput> readTxInputs(uint64_t inputCount) override {
-        std::vector<TxInput> inputs;
+    std::pmr::vector<TxInput> readTxInputs(uint64_t inputCount) {
+        std::pmr::vector<TxInput> inputs(mr);
+        inputs.reserve(inputCount);
         for (uint64_t i = 0; i < inputCount; i++) {
             TxOutpoint outpoint = readTxOutpoint();
             VarUint scriptLen = VarUint::readFrom(reader);
-            std::vector<uint8_t> scriptSig = readU8Vec(scriptLen.unwrap().value);
+            std::pmr::vector<uint8_t> scriptSig = readU8Vec(scriptLen.unwrap().value);
             uint32_t seqNo = reader.readU32();
-            inputs.push_back(TxInput(outpoint, scriptLen, scriptSig, seqNo, std::nullopt));
+            inputs.push_back(TxInput(outpoint, scriptLen, std::move(scriptSig), seqNo, std::nullopt));
         }
         return inputs;
     }
-    std::vector<TxOutput> readTxOutputs(uint64_t outputCount) override {
-        std::vector<TxOutput> outputs;
+    std::pmr::vector<TxOutput> readTxOutputs(uint64_t outputCount) {
+        std::pmr::vector<TxOutput> outputs(mr);
+        outputs.reserve(outputCount);
         for (uint64_t i = 0; i < outputCount; i++) {
             uint64_t value = reader.readU64();
             VarUint scriptLen = VarUint::readFrom(reader);
-            std::vector<uint8_t> scriptPubkey = readU8Vec(scriptLen.unwrap().value);
-            outputs.push_back(TxOutput(value, scriptLen, scriptPubkey));
+            std::pmr::vector<uint8_t> scriptPubkey = readU8Vec(scriptLen.unwrap().value);
+            outputs.push_back(TxOutput(value, scriptLen, std::move(scriptPubkey)));
         }
         return outputs;
     }
-    MerkleBranch readMerkleBranch() override {
+    MerkleBranch readMerkleBranch() {
         VarUint branchLength = VarUint::readFrom(reader);
         std::vector<std::array<uint8_t, 32>> hashes;
         for (uint64_t i = 0; i < branchLength.unwrap().value; i++) {
@@ -262,8 +323,8 @@ public:
         uint32_t sideMask = reader.readU32();
         return MerkleBranch(hashes, sideMask);
     }
-    AuxPowExtension readAuxPowExtension(uint8_t versionId) override {
-        RawTx coinbaseTx = readTx(versionId);
+    AuxPowExtension readAuxPowExtension() {
+        RawTx coinbaseTx = readTx();
         sha256d::Hash blockHash = sha256d::Hash::fromByteArray(read256Hash());
         MerkleBranch coinbaseBranch = readMerkleBranch();
         MerkleBranch blockchainBranch = readMerkleBranch();
@@ -272,11 +333,14 @@ public:
     }
 private:
     R& reader;
+    std::pmr::memory_resource* mr;
+    // Legacy serialization of the tx being hashed; reused across txs.
+    libbitcoin::system::data_chunk scratch;
 };
 
-template<typename R>
-BlockchainReadImpl<R> makeBlockchainRead(R& reader) {
-    return BlockchainReadImpl<R>(reader);
+template<typename C, typename R>
+BlockchainReadImpl<R, C> makeBlockchainRead(R& reader, std::pmr::memory_resource* mr = std::pmr::get_default_resource()) {
+    return BlockchainReadImpl<R, C>(reader, mr);
 }
 
 class FileReader : public io::Read {
@@ -297,14 +361,7 @@ public:
 
 class Witness {
 public:
-    static Witness fromSlice(const std::vector<std::vector<uint8_t>>& slices) {
+    static Witness fromSlice(std::pmr::vector<std::pmr::vector<uint8_t>> slices) {
         // implementation
     }
 };
-
-int main() {
-    // implementation
-    return 0;
-}
-
-
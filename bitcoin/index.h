@@ -1,3 +1,5 @@
+#pragma once
+
 #include <iostream>
 #include <unordered_map> 
 #include <fstream>
@@ -8,8 +10,23 @@
 #include <cstring>
 #include <cstdint>
 #include <cassert> 
+#include <array>
+#include <atomic>
+#include <thread>
+#include <tuple>
+#include <filesystem>
+#include <algorithm>
+#include <cmath>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <bitcoin/system.hpp>
 #include <leveldb/db.h> // leveldb::*
 #include <leveldb/write_batch.h> // leveldb::WriteBatch
+#include "../arena.h"
+#include "mod.h"
+#include "block_reader.h"
  
 using namespace std;
 class Hashtable {
@@ -32,6 +49,10 @@ const size_t DEFAULT_INSCRIPTION_HEIGHT = 100000;
 const size_t _DEFAULT_BLK_NUM = 10000;
 const uint64_t BLOCK_VALID_CHAIN = 4;
 const uint64_t BLOCK_HAVE_DATA = 8;
+const std::string BLOCKS_PATH = "blocks";
+const std::string BLK_XOR_KEY_FILE = "xor.dat";
+const char BLOCK_LOCATION_MAGIC[8] = {'O', 'R', 'D', 'I', 'L', 'O', 'C', '3'};
+const size_t BLOCK_HEADER_SIZE = 80;
 
 class BlkError : public std::exception {
 public:
@@ -53,11 +74,51 @@ private:
     std::string message_;
 };
  
-class BLK {
+std::string blk_file_name(uint64_t blk_index);
+std::array<uint8_t, 8> read_blk_xor_key(const std::filesystem::path& blocks_dir);
+
+// Reads a serialized block out of memory for BlockchainReadImpl.
+class SliceReader {
 public:
-    BLK(const std::string& btc_data_dir, uint64_t blk_index) {
-        // implementation
+    SliceReader(const uint8_t* data, size_t size) : data(data), size(size), pos(0) {}
+    void readExact(uint8_t* buffer, size_t n) {
+        if (n > size - pos) {
+            throw BlkError("Truncated block at offset " + std::to_string(pos));
+        }
+        std::memcpy(buffer, data + pos, n);
+        pos += n;
+    }
+    uint8_t readU8() {
+        uint8_t v;
+        readExact(&v, 1);
+        return v;
+    }
+    uint32_t readU32() {
+        uint32_t v;
+        readExact(reinterpret_cast<uint8_t*>(&v), 4);
+        return v;
+    }
+    uint64_t readU64() {
+        uint64_t v;
+        readExact(reinterpret_cast<uint8_t*>(&v), 8);
+        return v;
+    }
+    size_t position() const {
+        return pos;
+    }
+    // Bytes already read; `offset` must not exceed position().
+    const uint8_t* bytes(size_t offset) const {
+        return data + offset;
     }
+private:
+    const uint8_t* data;
+    size_t size;
+    size_t pos;
+};
+
+class BLK {
+public:
+    BLK(const std::string& btc_data_dir, uint64_t blk_index);
     void open() {
         // implementation
     }
@@ -67,11 +128,18 @@ public:
     Block read_block(uint64_t data_offset) {
         // implementation
     }
+    // Copies the raw serialized block into `buffer` without decoding it.
+    void read_raw_block(uint64_t data_offset, std::vector<uint8_t>& buffer);
+    // Decodes into `arena`; the block is valid until arena.reset().
+    template<typename C>
+    Block& read_block(uint64_t data_offset, BlockArena& arena);
     // other methods
-};
+private:
+    std::filesystem::path path_;
+    std::array<uint8_t, 8> xor_key_;
 
-class Block {
-    // implementation
+    uint32_t read_block_size(std::ifstream& file, uint64_t data_offset);
+    void read_bytes(std::ifstream& file, uint64_t offset, uint8_t* buffer, size_t n);
 };
 
 class IndexError : public std::exception {
@@ -89,6 +157,12 @@ public:
     IndexEntry(const std::vector<uint8_t>& block_hash, uint64_t blk_index, uint64_t data_offset, uint64_t version, uint64_t height, uint64_t status, uint64_t tx_count)
         : block_hash_(block_hash), blk_index_(blk_index), data_offset_(data_offset), version_(version), height_(height), status_(status), tx_count_(tx_count) {}
     // getters
+    uint64_t blk_index() const {
+        return blk_index_;
+    }
+    uint64_t data_offset() const {
+        return data_offset_;
+    }
 private:
     std::vector<uint8_t> block_hash_;
     uint64_t blk_index_;
@@ -101,20 +175,54 @@ private:
 
 class Index {
 public:
-    Index(const std::string& btc_data_dir) {
+    Index(const std::string& btc_data_dir, Coin coin) : coin_(coin) {
         // implementation
     }
+    // Builds the index from blk*.dat directly instead of Core's blocks/index.
+    Index(const std::string& btc_data_dir, Coin coin, const std::string& location_table_path);
     Block catch_block(uint64_t height) {
         // implementation
     }
+    Block& catch_block(uint64_t height, BlockArena& arena) {
+        const IndexEntry& entry = entry_at(height);
+        BLK& blk = blk_at(entry.blk_index());
+        return visit_coin(coin_, [&](auto c) -> Block& { return blk.read_block<decltype(c)>(entry.data_offset(), arena); });
+    }
+    // `buffer` is resized to the block and can be reused across heights.
+    void catch_raw_block(uint64_t height, std::vector<uint8_t>& buffer) {
+        const IndexEntry& entry = entry_at(height);
+        blk_at(entry.blk_index()).read_raw_block(entry.data_offset(), buffer);
+    }
     const IndexEntry* get_index_entry(uint64_t height) {
         // implementation
     }
     IndexEntry get_block_entry_by_block_hash(const std::vector<uint8_t>& block_hash) {
         // implementation
     }
+    Coin coin() const {
+        return coin_;
+    }
+    size_t memory_usage() const {
+        return entries_.size() * (sizeof(IndexEntry) + 32 + 64) + blks_.size() * (sizeof(BLK) + 64);
+    }
 private:
+    const IndexEntry& entry_at(uint64_t height) const {
+        auto found = entries_.find(height);
+        if (found == entries_.end()) {
+            throw IndexError("No block at height " + std::to_string(height));
+        }
+        return found->second;
+    }
+    BLK& blk_at(uint64_t blk_index) {
+        auto found = blks_.find(blk_index);
+        if (found == blks_.end()) {
+            throw IndexError("Unknown blk file " + std::to_string(blk_index));
+        }
+        return found->second;
+    }
+
     std::string btc_data_dir_;
+    Coin coin_;
     std::unordered_map<uint64_t, IndexEntry> entries_;
     uint64_t max_height_;
     std::unordered_map<uint64_t, uint64_t> max_height_in_blk_;
@@ -185,20 +293,524 @@ std::pair<std::unordered_map<uint64_t, IndexEntry>, uint64_t, std::unordered_map
     return std::make_pair(index, max_height, max_height_in_blk, blks);
 }
 
-int main() {
-    std::string btc_data_dir = "/path/to/btc_data_dir";
+struct ScannedBlock {
+    std::array<uint8_t, 32> hash;
+    std::array<uint8_t, 32> prev_hash;
+    uint32_t blk_index;
+    uint32_t data_offset;
+    uint32_t version;
+    uint32_t tx_count;
+    uint32_t bits;
+};
+
+std::string blk_file_name(uint64_t blk_index) {
+    char name[16];
+    std::snprintf(name, sizeof(name), "blk%05llu.dat", static_cast<unsigned long long>(blk_index));
+    return name;
+}
+
+// Core >= 28 obfuscates blk files with an 8 byte XOR key; a zero key is a no-op.
+std::array<uint8_t, 8> read_blk_xor_key(const std::filesystem::path& blocks_dir) {
+    std::array<uint8_t, 8> key{};
+    std::ifstream file(blocks_dir / BLK_XOR_KEY_FILE, std::ios::binary);
+    if (file) {
+        file.read(reinterpret_cast<char*>(key.data()), key.size());
+    }
+    return key;
+}
+
+uint64_t read_compact_size(const uint8_t* data, size_t available) {
+    if (available == 0) {
+        return 0;
+    }
+    uint8_t first = data[0];
+    uint64_t n = 0;
+    size_t width = first == 0xfd ? 2 : first == 0xfe ? 4 : first == 0xff ? 8 : 0;
+    if (width == 0) {
+        return first;
+    }
+    if (available < width + 1) {
+        return 0;
+    }
+    for (size_t i = 0; i < width; i++) {
+        n |= static_cast<uint64_t>(data[1 + i]) << (8 * i);
+    }
+    return n;
+}
+
+// Finds every block in one blk file by its magic + size prefix and hashes its
+// header. Zero padding from Core's preallocation and torn records are skipped.
+// The file is mapped rather than read, so concurrent scans only touch the
+// pages they are walking instead of holding whole files in memory.
+std::vector<ScannedBlock> scan_blk_file(const std::filesystem::path& path, uint32_t blk_index, uint32_t magic, const std::array<uint8_t, 8>& xor_key) {
+    std::vector<ScannedBlock> blocks;
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw BlkError("Failed to open " + path.string());
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw BlkError("Failed to stat " + path.string());
+    }
+    size_t file_size = static_cast<size_t>(st.st_size);
+    if (file_size == 0) {
+        ::close(fd);
+        return blocks;
+    }
+    void* addr = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        throw BlkError("Failed to mmap " + path.string());
+    }
+    madvise(addr, file_size, MADV_SEQUENTIAL);
+    const uint8_t* data = static_cast<const uint8_t*>(addr);
+    auto copy = [&](size_t pos, uint8_t* out, size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            out[i] = data[pos + i] ^ xor_key[(pos + i) % xor_key.size()];
+        }
+    };
+
+    size_t pos = 0;
+    uint8_t header[BLOCK_HEADER_SIZE + 9];
+    while (pos + 8 + BLOCK_HEADER_SIZE <= file_size) {
+        uint32_t record_magic, size;
+        copy(pos, reinterpret_cast<uint8_t*>(&record_magic), 4);
+        if (record_magic != magic) {
+            pos++;
+            continue;
+        }
+        copy(pos + 4, reinterpret_cast<uint8_t*>(&size), 4);
+        if (size < BLOCK_HEADER_SIZE || pos + 8 + size > file_size) {
+            pos++;
+            continue;
+        }
+        size_t header_len = std::min<size_t>(sizeof(header), size);
+        copy(pos + 8, header, header_len);
+        libbitcoin::system::hash_digest hash = libbitcoin::system::sha256_hash(libbitcoin::system::sha256_hash(libbitcoin::system::data_chunk(header, header + BLOCK_HEADER_SIZE)));
+
+        ScannedBlock block;
+        std::copy(hash.begin(), hash.end(), block.hash.begin());
+        std::memcpy(block.prev_hash.data(), header + 4, 32);
+        std::memcpy(&block.version, header, 4);
+        std::memcpy(&block.bits, header + 72, 4);
+        block.blk_index = blk_index;
+        block.data_offset = static_cast<uint32_t>(pos + 8);
+        block.tx_count = static_cast<uint32_t>(read_compact_size(header + BLOCK_HEADER_SIZE, header_len - BLOCK_HEADER_SIZE));
+        blocks.push_back(block);
+        pos += 8 + size;
+    }
+    munmap(addr, file_size);
+    return blocks;
+}
+
+// Every block found in one blk file, with the file size it was scanned at.
+struct ScannedBlkFile {
+    uint64_t size = 0;
+    std::vector<ScannedBlock> blocks;
+};
+
+struct BlockLocationTableHeader {
+    char magic[8];
+    uint32_t blk_file_count;
+    uint32_t reserved;
+    uint64_t chain_length;
+};
+
+// Loads what save_block_location_table persisted: the size each blk file had
+// when it was last scanned and the best chain in height order.
+bool load_block_location_table(const std::string& path, std::vector<uint64_t>& sizes, std::vector<ScannedBlock>& chain) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    BlockLocationTableHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))
+        || std::memcmp(header.magic, BLOCK_LOCATION_MAGIC, sizeof(header.magic)) != 0) {
+        return false;
+    }
+    sizes.resize(header.blk_file_count);
+    chain.resize(header.chain_length);
+    if (!file.read(reinterpret_cast<char*>(sizes.data()), sizes.size() * sizeof(uint64_t))
+        || !file.read(reinterpret_cast<char*>(chain.data()), chain.size() * sizeof(ScannedBlock))) {
+        sizes.clear();
+        chain.clear();
+        return false;
+    }
+    return true;
+}
+
+void save_block_location_table(const std::string& path, const std::vector<uint64_t>& sizes, const std::vector<ScannedBlock>& chain) {
+    std::string tmp_path = path + ".tmp";
+    std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+    BlockLocationTableHeader header;
+    std::memcpy(header.magic, BLOCK_LOCATION_MAGIC, sizeof(header.magic));
+    header.blk_file_count = static_cast<uint32_t>(sizes.size());
+    header.reserved = 0;
+    header.chain_length = chain.size();
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(sizes.data()), sizes.size() * sizeof(uint64_t));
+    file.write(reinterpret_cast<const char*>(chain.data()), chain.size() * sizeof(ScannedBlock));
+    file.close();
+    if (!file) {
+        throw IndexError("Failed to write block location table: " + tmp_path);
+    }
+    std::filesystem::rename(tmp_path, path);
+}
+
+// Scans the listed blk files in parallel, one file per worker.
+std::vector<ScannedBlkFile> scan_blk_files(const std::filesystem::path& blocks_dir, const std::vector<uint32_t>& which, const std::vector<uint64_t>& sizes, uint32_t magic) {
+    std::vector<ScannedBlkFile> files(which.size());
+    std::array<uint8_t, 8> xor_key = read_blk_xor_key(blocks_dir);
+    std::atomic<size_t> next_file(0);
+    std::vector<std::thread> workers;
+    size_t worker_count = std::min<size_t>(which.size(), std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<std::string> errors(worker_count);
+    for (size_t w = 0; w < worker_count; w++) {
+        workers.emplace_back([&, w]() {
+            try {
+                for (size_t k = next_file++; k < which.size(); k = next_file++) {
+                    uint32_t i = which[k];
+                    files[k].blocks = scan_blk_file(blocks_dir / blk_file_name(i), i, magic, xor_key);
+                    files[k].size = sizes[i];
+                }
+            } catch (const std::exception& e) {
+                errors[w] = e.what();
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    for (const auto& error : errors) {
+        if (!error.empty()) {
+            throw IndexError(error);
+        }
+    }
+    return files;
+}
+
+// Block hashes are uniformly distributed, so their first bytes hash well enough.
+struct BlockHashHasher {
+    size_t operator()(const std::array<uint8_t, 32>& hash) const {
+        size_t h;
+        std::memcpy(&h, hash.data(), sizeof(h));
+        return h;
+    }
+};
+
+// Expected number of hashes for a header with compact target `bits`,
+// 2^256 / (target + 1).
+long double block_work(uint32_t bits) {
+    uint32_t exponent = bits >> 24;
+    uint32_t mantissa = bits & 0x007fffff;
+    if (mantissa == 0 || (bits & 0x00800000) != 0) {
+        return 0;
+    }
+    long double target = std::ldexp(static_cast<long double>(mantissa), 8 * (static_cast<int>(exponent) - 3));
+    return std::ldexp(1.0L, 256) / (target + 1);
+}
+
+// Links scanned blocks by prev_hash from genesis and returns the chain with
+// the most accumulated work in height order. Blocks whose parent was not
+// found are orphans and ignored. When several tips tie on work the chain
+// stops at their common ancestor rather than guessing which one Core chose.
+std::vector<ScannedBlock> link_best_chain(const std::vector<ScannedBlkFile>& files) {
+    std::unordered_map<std::string, const ScannedBlock*> by_hash;
+    std::unordered_map<std::string, std::vector<const ScannedBlock*>> children;
+    const ScannedBlock* genesis = nullptr;
+    std::array<uint8_t, 32> zero{};
+    for (const auto& blk : files) {
+        for (const auto& block : blk.blocks) {
+            std::string hash(block.hash.begin(), block.hash.end());
+            if (!by_hash.emplace(hash, &block).second) {
+                continue;
+            }
+            if (block.prev_hash == zero) {
+                genesis = &block;
+            } else {
+                children[std::string(block.prev_hash.begin(), block.prev_hash.end())].push_back(&block);
+            }
+        }
+    }
+    if (genesis == nullptr) {
+        throw IndexError("Genesis block not found in blk files.");
+    }
+
+    std::unordered_map<const ScannedBlock*, const ScannedBlock*> parent;
+    std::unordered_map<const ScannedBlock*, uint64_t> heights;
+    std::unordered_map<const ScannedBlock*, long double> work;
+    std::vector<const ScannedBlock*> frontier = {genesis};
+    std::vector<const ScannedBlock*> tips;
+    heights[genesis] = 0;
+    work[genesis] = block_work(genesis->bits);
+    long double best_work = 0;
+    while (!frontier.empty()) {
+        const ScannedBlock* block = frontier.back();
+        frontier.pop_back();
+        long double chain_work = work[block];
+        // Equal-bits siblings accumulate the same sums, so ties compare equal.
+        if (chain_work > best_work) {
+            best_work = chain_work;
+            tips = {block};
+        } else if (chain_work == best_work) {
+            tips.push_back(block);
+        }
+        auto found = children.find(std::string(block->hash.begin(), block->hash.end()));
+        if (found == children.end()) {
+            continue;
+        }
+        for (const ScannedBlock* child : found->second) {
+            parent[child] = block;
+            heights[child] = heights[block] + 1;
+            work[child] = chain_work + block_work(child->bits);
+            frontier.push_back(child);
+        }
+    }
+
+    // Walk tied tips back in lockstep until they meet.
+    while (tips.size() > 1) {
+        uint64_t top = 0;
+        for (const ScannedBlock* tip : tips) {
+            top = std::max(top, heights[tip]);
+        }
+        std::vector<const ScannedBlock*> next;
+        for (const ScannedBlock* tip : tips) {
+            const ScannedBlock* block = heights[tip] == top ? parent[tip] : tip;
+            if (std::find(next.begin(), next.end(), block) == next.end()) {
+                next.push_back(block);
+            }
+        }
+        tips.swap(next);
+    }
+    const ScannedBlock* tip = tips.front();
+
+    std::vector<ScannedBlock> chain(heights[tip] + 1);
+    for (const ScannedBlock* block = tip; block != nullptr; ) {
+        chain[heights[block]] = *block;
+        auto found = parent.find(block);
+        block = found == parent.end() ? nullptr : found->second;
+    }
+    return chain;
+}
+
+// Extends a persisted best chain with the blocks of rescanned blk files.
+// Only the new blocks are linked; the chain is walked once to drop blocks it
+// already holds and to find the heights the rest hang off. A branch replaces
+// the chain's tip only with strictly more work, so the incumbent wins ties as
+// it does in Core. Returns false when a new block's parent is neither in the
+// chain nor among the new blocks, i.e. it extends a side branch that was not
+// persisted; the caller then relinks from a full scan.
+bool extend_best_chain(std::vector<ScannedBlock>& chain, const std::vector<ScannedBlkFile>& scanned) {
+    using Hash = std::array<uint8_t, 32>;
+    std::unordered_map<Hash, const ScannedBlock*, BlockHashHasher> fresh;
+    std::unordered_map<Hash, uint64_t, BlockHashHasher> attach_height;
+    for (const auto& blk : scanned) {
+        for (const auto& block : blk.blocks) {
+            fresh.emplace(block.hash, &block);
+            attach_height.emplace(block.prev_hash, UINT64_MAX);
+        }
+    }
+    for (uint64_t height = 0; height < chain.size(); height++) {
+        fresh.erase(chain[height].hash);
+        auto found = attach_height.find(chain[height].hash);
+        if (found != attach_height.end()) {
+            found->second = height;
+        }
+    }
+    if (fresh.empty()) {
+        return true;
+    }
+
+    // Roots hang off the chain, everything else off another new block. Both
+    // are collected in scan order so ties between branches resolve the same
+    // way on every start.
+    std::vector<const ScannedBlock*> roots;
+    std::unordered_map<Hash, std::vector<const ScannedBlock*>, BlockHashHasher> children;
+    uint64_t lowest = chain.size() - 1;
+    for (const auto& blk : scanned) {
+        for (const auto& block : blk.blocks) {
+            auto self = fresh.find(block.hash);
+            if (self == fresh.end() || self->second != &block) {
+                continue;
+            }
+            if (fresh.count(block.prev_hash) > 0) {
+                children[block.prev_hash].push_back(&block);
+                continue;
+            }
+            uint64_t height = attach_height.at(block.prev_hash);
+            if (height == UINT64_MAX) {
+                return false;
+            }
+            roots.push_back(&block);
+            lowest = std::min(lowest, height);
+        }
+    }
+
+    // Work is compared relative to the lowest attach point.
+    std::vector<long double> chain_work(chain.size() - lowest, 0);
+    for (uint64_t height = lowest + 1; height < chain.size(); height++) {
+        chain_work[height - lowest] = chain_work[height - lowest - 1] + block_work(chain[height].bits);
+    }
+    long double best_work = chain_work.back();
+    const ScannedBlock* best_tip = nullptr;
+    std::unordered_map<const ScannedBlock*, const ScannedBlock*> parent;
+    std::unordered_map<const ScannedBlock*, long double> work;
+    for (const ScannedBlock* root : roots) {
+        work[root] = chain_work[attach_height.at(root->prev_hash) - lowest] + block_work(root->bits);
+        std::vector<const ScannedBlock*> frontier = {root};
+        while (!frontier.empty()) {
+            const ScannedBlock* block = frontier.back();
+            frontier.pop_back();
+            if (work[block] > best_work) {
+                best_work = work[block];
+                best_tip = block;
+            }
+            auto found = children.find(block->hash);
+            if (found == children.end()) {
+                continue;
+            }
+            for (auto child = found->second.rbegin(); child != found->second.rend(); ++child) {
+                parent[*child] = block;
+                work[*child] = work[block] + block_work((*child)->bits);
+                frontier.push_back(*child);
+            }
+        }
+    }
+    if (best_tip == nullptr) {
+        return true;
+    }
+
+    std::vector<ScannedBlock> branch;
+    const ScannedBlock* block = best_tip;
+    for (;;) {
+        branch.push_back(*block);
+        auto found = parent.find(block);
+        if (found == parent.end()) {
+            break;
+        }
+        block = found->second;
+    }
+    chain.resize(attach_height.at(block->prev_hash) + 1);
+    chain.insert(chain.end(), branch.rbegin(), branch.rend());
+    return true;
+}
+
+// Alternative to parse_index_for_ordinals that does not touch Core's
+// blocks/index LevelDB. The best chain is persisted in height order together
+// with the size each blk file was scanned at, so a start where nothing changed
+// loads it directly and one where Core appended only rescans the grown or new
+// files and links their blocks onto the persisted tip. A fresh table, a blk
+// file that shrank (e.g. after -reindex) or a block extending an unpersisted
+// side branch falls back to scanning every file and relinking from genesis.
+std::tuple<std::unordered_map<uint64_t, IndexEntry>, uint64_t, std::unordered_map<uint64_t, uint64_t>, std::unordered_map<uint64_t, BLK>> parse_blk_files_for_ordinals(const std::string& btc_data_dir, uint32_t magic, const std::string& location_table_path) {
+    std::filesystem::path blocks_dir = std::filesystem::path(btc_data_dir) / BLOCKS_PATH;
+    uint32_t blk_file_count = 0;
+    while (std::filesystem::exists(blocks_dir / blk_file_name(blk_file_count))) {
+        blk_file_count++;
+    }
+    if (blk_file_count == 0) {
+        throw IndexError("No blk files found in: " + blocks_dir.string());
+    }
+
+    std::vector<uint64_t> scanned_sizes;
+    std::vector<ScannedBlock> chain;
+    bool relink = !load_block_location_table(location_table_path, scanned_sizes, chain) || chain.empty() || scanned_sizes.size() > blk_file_count;
+    std::vector<uint32_t> stale;
+    std::vector<uint64_t> sizes(blk_file_count);
+    for (uint32_t i = 0; i < blk_file_count; i++) {
+        sizes[i] = std::filesystem::file_size(blocks_dir / blk_file_name(i));
+        if (i >= scanned_sizes.size() || scanned_sizes[i] != sizes[i]) {
+            stale.push_back(i);
+            relink = relink || (i < scanned_sizes.size() && sizes[i] < scanned_sizes[i]);
+        }
+    }
+
     std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
-    std::unordered_map<uint64_t, IndexEntry> entries;
-    uint64_t max_height;
+    if (!relink && !stale.empty()) {
+        relink = !extend_best_chain(chain, scan_blk_files(blocks_dir, stale, sizes, magic));
+    }
+    if (relink) {
+        stale.resize(blk_file_count);
+        for (uint32_t i = 0; i < blk_file_count; i++) {
+            stale[i] = i;
+        }
+        chain = link_best_chain(scan_blk_files(blocks_dir, stale, sizes, magic));
+    }
+    if (!stale.empty()) {
+        save_block_location_table(location_table_path, sizes, chain);
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+        std::cout << "Scanned " << stale.size() << " of " << blk_file_count << " blk files, " << std::chrono::duration_cast<std::chrono::seconds>(end - start).count() << "s." << std::endl;
+    }
+
+    std::unordered_map<uint64_t, IndexEntry> index;
     std::unordered_map<uint64_t, uint64_t> max_height_in_blk;
     std::unordered_map<uint64_t, BLK> blks;
-    try {
-        std::tie(entries, max_height, max_height_in_blk, blks) = parse_index_for_ordinals(btc_data_dir);
-        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
-        std::cout << "Parsed bitcoin index, " << std::chrono::duration_cast<std::chrono::seconds>(end - start).count() << "s." << std::endl;
-    } catch (const IndexError& e) {
-        std::cerr << "Error: " << e.what() << std::endl;
+    for (uint64_t height = 0; height < chain.size(); height++) {
+        const ScannedBlock& block = chain[height];
+        IndexEntry record(std::vector<uint8_t>(block.hash.begin(), block.hash.end()), block.blk_index, block.data_offset, block.version, height, BLOCK_VALID_CHAIN | BLOCK_HAVE_DATA, block.tx_count);
+        max_height_in_blk[block.blk_index] = height;
+        blks.emplace(block.blk_index, BLK(btc_data_dir, block.blk_index));
+        index.emplace(height, record);
+    }
+    uint64_t max_height = chain.size() - 1;
+    std::cout << "All blk entries are valid until height: " << max_height << "." << std::endl;
+    return std::make_tuple(index, max_height, max_height_in_blk, blks);
+}
+
+BLK::BLK(const std::string& btc_data_dir, uint64_t blk_index) {
+    std::filesystem::path blocks_dir = std::filesystem::path(btc_data_dir) / BLOCKS_PATH;
+    path_ = blocks_dir / blk_file_name(blk_index);
+    xor_key_ = read_blk_xor_key(blocks_dir);
+}
+
+// Reads n bytes at a file offset, undoing the xor.dat obfuscation.
+void BLK::read_bytes(std::ifstream& file, uint64_t offset, uint8_t* buffer, size_t n) {
+    file.seekg(offset);
+    if (!file.read(reinterpret_cast<char*>(buffer), n)) {
+        throw BlkError("Failed to read " + std::to_string(n) + " bytes at " + std::to_string(offset) + " from " + path_.string());
+    }
+    for (size_t i = 0; i < n; i++) {
+        buffer[i] ^= xor_key_[(offset + i) % xor_key_.size()];
     }
-    return 0;
 }
 
+// data_offset points just past the record's magic and size prefix.
+uint32_t BLK::read_block_size(std::ifstream& file, uint64_t data_offset) {
+    if (data_offset < 8) {
+        throw BlkError("Invalid block offset " + std::to_string(data_offset) + " in " + path_.string());
+    }
+    uint32_t size;
+    read_bytes(file, data_offset - 4, reinterpret_cast<uint8_t*>(&size), 4);
+    return size;
+}
+
+void BLK::read_raw_block(uint64_t data_offset, std::vector<uint8_t>& buffer) {
+    std::ifstream file(path_, std::ios::binary);
+    if (!file) {
+        throw BlkError("Failed to open " + path_.string());
+    }
+    uint32_t size = read_block_size(file, data_offset);
+    buffer.resize(size);
+    read_bytes(file, data_offset, buffer.data(), size);
+}
+
+// The serialized bytes and every container of the decoded block come from
+// the arena, so nothing outlives arena.reset().
+template<typename C>
+Block& BLK::read_block(uint64_t data_offset, BlockArena& arena) {
+    std::ifstream file(path_, std::ios::binary);
+    if (!file) {
+        throw BlkError("Failed to open " + path_.string());
+    }
+    uint32_t size = read_block_size(file, data_offset);
+    uint8_t* bytes = static_cast<uint8_t*>(arena.get()->allocate(size, 1));
+    read_bytes(file, data_offset, bytes, size);
+    SliceReader reader(bytes, size);
+    BlockchainReadImpl<SliceReader, C> decoder(reader, arena.get());
+    return arena.make<Block>(decoder.readBlock(size));
+}
+
+Index::Index(const std::string& btc_data_dir, Coin coin, const std::string& location_table_path) : btc_data_dir_(btc_data_dir), coin_(coin) {
+    std::tie(entries_, max_height_, max_height_in_blk_, blks_) = parse_blk_files_for_ordinals(btc_data_dir, coin_magic(coin), location_table_path);
+}
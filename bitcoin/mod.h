@@ -1,18 +1,96 @@
+#pragma once
+
+#include <string>
+#include <exception>
 #include "crypto.h"
 
-class Coin: Trait {
+// Coin parameters are compile-time policies rather than a runtime trait so the
+// block decoder (BlockchainReadImpl<R, C>) is monomorphized per coin and the
+// magic/AuxPow/version checks fold into constants.
+//
+// A policy provides:
+//   NAME                        display name
+//   MAGIC                       magic value to identify blocks
+//   VERSION_ID                  https://en.bitcoin.it/wiki/List_of_address_prefixes
+//   GENESIS                     genesis block hash (hex, display order)
+//   HAS_AUX_POW                 whether AuxPow is ever active
+//   AUX_POW_ACTIVATION_VERSION  activates AuxPow for this version and above
+//   DEFAULT_FOLDER              default working directory to look for datadir
+
+struct Bitcoin {
+    static constexpr const char* NAME = "Bitcoin";
+    static constexpr uint32_t MAGIC = 0xd9b4bef9;
+    static constexpr uint8_t VERSION_ID = 0x00;
+    static constexpr const char* GENESIS = "000000000019d6689c085ae165831e934ff763ae46a2a6c172b3f1b60a8ce26f";
+    static constexpr bool HAS_AUX_POW = false;
+    static constexpr uint32_t AUX_POW_ACTIVATION_VERSION = 0;
+    static constexpr const char* DEFAULT_FOLDER = ".bitcoin";
+};
+
+struct TestNet3 {
+    static constexpr const char* NAME = "TestNet3";
+    static constexpr uint32_t MAGIC = 0x0709110b;
+    static constexpr uint8_t VERSION_ID = 0x6f;
+    static constexpr const char* GENESIS = "000000000933ea01ad0ee984209779baaec3ced90fa3f408719526f8d77f4943";
+    static constexpr bool HAS_AUX_POW = false;
+    static constexpr uint32_t AUX_POW_ACTIVATION_VERSION = 0;
+    static constexpr const char* DEFAULT_FOLDER = ".bitcoin/testnet3";
+};
+
+struct Signet {
+    static constexpr const char* NAME = "Signet";
+    static constexpr uint32_t MAGIC = 0x40cf030a;
+    static constexpr uint8_t VERSION_ID = 0x6f;
+    static constexpr const char* GENESIS = "00000008819873e925422c1ff0f99f7cc9bbb232af63a077a480a3633bee1ef6";
+    static constexpr bool HAS_AUX_POW = false;
+    static constexpr uint32_t AUX_POW_ACTIVATION_VERSION = 0;
+    static constexpr const char* DEFAULT_FOLDER = ".bitcoin/signet";
+};
+
+class CoinError : public std::exception {
 public:
-    String name();
-    // Magic value to identify blocks
-    uint32 magic(Coin self);
-    // https://en.bitcoin.it/wiki/List_of_address_prefixes
-    uint8  version_id(Coin self);
-    // Returns genesis hash
-    sha256d::Hash genesis(Coin self)  ;
-    // Activates AuxPow for the returned version and above
-   Option<uint32> aux_pow_activation_version(Coin self) -> Option<uint32> {
-        None
+    CoinError(const std::string& message) : message(message) {}
+    const char* what() const noexcept override {
+        return message.c_str();
     }
-    // Default working directory to look for datadir, for example .bitcoin
-    PathBuf default_folder(Coin self) ;
-}
\ No newline at end of file
+private:
+    std::string message;
+};
+
+// Configured network, resolved to a policy at the few places that decode.
+enum class Coin {
+    Bitcoin,
+    TestNet3,
+    Signet
+};
+
+inline Coin coin_from_name(const std::string& name) {
+    if (name == "bitcoin") {
+        return Coin::Bitcoin;
+    }
+    if (name == "testnet3") {
+        return Coin::TestNet3;
+    }
+    if (name == "signet") {
+        return Coin::Signet;
+    }
+    throw CoinError("Unknown network: " + name + ", expected bitcoin, testnet3 or signet.");
+}
+
+// Calls f with a value of the policy type for `coin`, so callers can
+// instantiate a template per coin: visit_coin(coin, [&](auto c) { f<decltype(c)>(); }).
+template<typename F>
+decltype(auto) visit_coin(Coin coin, F&& f) {
+    switch (coin) {
+        case Coin::TestNet3:
+            return f(TestNet3{});
+        case Coin::Signet:
+            return f(Signet{});
+        default:
+            return f(Bitcoin{});
+    }
+}
+
+inline uint32_t coin_magic(Coin coin) {
+    return visit_coin(coin, [](auto c) { return decltype(c)::MAGIC; });
+}
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <bitcoin/system.hpp>
+
+const size_t SKIM_HEADER_SIZE = 80;
+const uint32_t SKIM_NULL_VOUT = 0xffffffff;
+
+class SkimError : public std::exception {
+public:
+    SkimError(const std::string& message) : message(message) {}
+    const char* what() const noexcept override {
+        return message.c_str();
+    }
+private:
+    std::string message;
+};
+
+struct SkimOutput {
+    std::array<uint8_t, 32> txid;
+    uint32_t vout;
+    uint64_t value;
+};
+
+struct SkimSpend {
+    std::array<uint8_t, 32> txid;
+    uint32_t vout;
+};
+
+// Flat result of skimming one block: every created output and every spent
+// outpoint, in transaction order. Reused across blocks to avoid reallocating.
+struct ValueSkim {
+    std::vector<SkimOutput> outputs;
+    std::vector<SkimSpend> spends;
+    std::vector<uint8_t> scratch;
+
+    void clear() {
+        outputs.clear();
+        spends.clear();
+    }
+};
+
+// Display-order hex, matching sha256d::Hash::to_string().
+inline std::string txid_to_string(const std::array<uint8_t, 32>& txid) {
+    static const char* digits = "0123456789abcdef";
+    std::string hex(64, '0');
+    for (size_t i = 0; i < 32; i++) {
+        uint8_t b = txid[31 - i];
+        hex[2 * i] = digits[b >> 4];
+        hex[2 * i + 1] = digits[b & 0xf];
+    }
+    return hex;
+}
+
+// Walks raw block bytes without materializing scripts or witnesses: scripts
+// and witness items are skipped by length, and only txids, output values and
+// spent outpoints are emitted. This is all index_output_value needs for
+// heights below the first inscription.
+class ValueSkimmer {
+public:
+    ValueSkimmer(const uint8_t* data, size_t size) : data(data), size(size), pos(0) {}
+
+    template<typename C>
+    void skim(ValueSkim& out) {
+        static_assert(!C::HAS_AUX_POW, "value skimming does not handle AuxPow headers");
+        out.clear();
+        skip(SKIM_HEADER_SIZE);
+        uint64_t tx_count = read_compact_size();
+        for (uint64_t i = 0; i < tx_count; i++) {
+            skim_tx(out);
+        }
+    }
+
+private:
+    const uint8_t* data;
+    size_t size;
+    size_t pos;
+
+    // pos never exceeds size, so this cannot wrap even for a corrupt length
+    // near 2^64.
+    void need(uint64_t n) const {
+        if (n > size - pos) {
+            throw SkimError("Truncated block at offset " + std::to_string(pos));
+        }
+    }
+
+    void skip(uint64_t n) {
+        need(n);
+        pos += n;
+    }
+
+    uint32_t read_u32() {
+        need(4);
+        uint32_t v;
+        std::memcpy(&v, data + pos, 4);
+        pos += 4;
+        return v;
+    }
+
+    uint64_t read_u64() {
+        need(8);
+        uint64_t v;
+        std::memcpy(&v, data + pos, 8);
+        pos += 8;
+        return v;
+    }
+
+    uint64_t read_compact_size() {
+        need(1);
+        uint8_t first = data[pos++];
+        if (first < 0xfd) {
+            return first;
+        }
+        size_t width = first == 0xfd ? 2 : first == 0xfe ? 4 : 8;
+        need(width);
+        uint64_t n = 0;
+        for (size_t i = 0; i < width; i++) {
+            n |= static_cast<uint64_t>(data[pos + i]) << (8 * i);
+        }
+        pos += width;
+        return n;
+    }
+
+    void skim_tx(ValueSkim& out) {
+        size_t start = pos;
+        skip(4);
+        bool segwit = false;
+        need(2);
+        if (data[pos] == 0x00 && data[pos + 1] != 0x00) {
+            segwit = true;
+            pos += 2;
+        }
+        size_t body_start = pos;
+
+        uint64_t in_count = read_compact_size();
+        for (uint64_t i = 0; i < in_count; i++) {
+            need(36);
+            SkimSpend spend;
+            std::memcpy(spend.txid.data(), data + pos, 32);
+            std::memcpy(&spend.vout, data + pos + 32, 4);
+            pos += 36;
+            if (spend.vout != SKIM_NULL_VOUT || spend.txid != std::array<uint8_t, 32>{}) {
+                out.spends.push_back(spend);
+            }
+            skip(read_compact_size());
+            skip(4);
+        }
+
+        size_t outputs_start = out.outputs.size();
+        uint64_t out_count = read_compact_size();
+        for (uint64_t i = 0; i < out_count; i++) {
+            SkimOutput output;
+            output.vout = static_cast<uint32_t>(i);
+            output.value = read_u64();
+            skip(read_compact_size());
+            out.outputs.push_back(output);
+        }
+        size_t body_end = pos;
+
+        if (segwit) {
+            for (uint64_t i = 0; i < in_count; i++) {
+                uint64_t items = read_compact_size();
+                for (uint64_t j = 0; j < items; j++) {
+                    skip(read_compact_size());
+                }
+            }
+        }
+        skip(4);
+
+        // txid commits to the legacy serialization: version, inputs, outputs, locktime.
+        std::vector<uint8_t>& s = out.scratch;
+        s.clear();
+        s.insert(s.end(), data + start, data + start + 4);
+        s.insert(s.end(), data + body_start, data + body_end);
+        s.insert(s.end(), data + pos - 4, data + pos);
+        libbitcoin::system::hash_digest txid = libbitcoin::system::sha256_hash(libbitcoin::system::sha256_hash(s));
+        for (size_t i = outputs_start; i < out.outputs.size(); i++) {
+            std::memcpy(out.outputs[i].txid.data(), txid.data(), 32);
+        }
+    }
+};
@@ -0,0 +1,557 @@
+#pragma once
+
+#include <iostream>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <array>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include <functional>
+#include <optional>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zstd.h>
+#include <zdict.h>
+#include <bitcoin/system.hpp>
+#include "kill_point.h"
+
+namespace fs = std::filesystem;
+
+const char CONTENT_SEGMENT_MAGIC[8] = {'O', 'R', 'D', 'I', 'S', 'E', 'G', '1'};
+const uint64_t CONTENT_SEGMENT_MAX_SIZE = 1ull << 30;
+const uint32_t CONTENT_MAX_SEGMENTS = 1 << 16;
+const size_t CONTENT_DICT_SIZE = 112640;
+const size_t CONTENT_DICT_MAX_SAMPLES = 4096;
+const size_t CONTENT_DICT_MAX_SAMPLE_BYTES = 8 << 20;
+const size_t CONTENT_DICT_MAX_SAMPLE_SIZE = 16 << 10;
+const int CONTENT_COMPRESSION_LEVEL = 9;
+// compressed_len (4) + raw_len (4) + sha256 (32)
+const size_t CONTENT_RECORD_HEADER_SIZE = 40;
+// Content index key holding the last segment id (4) and its committed size (8).
+// Every other key is a 32 byte sha256.
+const std::string CONTENT_INDEX_TAIL_KEY = "tail";
+
+class ContentStoreError : public std::exception {
+public:
+    ContentStoreError(const std::string& message) : message(message) {}
+    const char* what() const noexcept override {
+        return message.c_str();
+    }
+private:
+    std::string message;
+};
+
+// Fixed 48 byte value stored in the KV tables in place of an inscription body.
+struct ContentPointer {
+    uint32_t segment;
+    uint64_t offset;
+    uint32_t len;
+    std::array<uint8_t, 32> hash;
+
+    static const size_t ENCODED_SIZE = 4 + 8 + 4 + 32;
+
+    std::string encode() const {
+        std::string out(ENCODED_SIZE, '\0');
+        std::memcpy(&out[0], &segment, 4);
+        std::memcpy(&out[4], &offset, 8);
+        std::memcpy(&out[12], &len, 4);
+        std::memcpy(&out[16], hash.data(), 32);
+        return out;
+    }
+
+    static ContentPointer decode(const std::string& data) {
+        if (data.size() != ENCODED_SIZE) {
+            throw ContentStoreError("Invalid content pointer size: " + std::to_string(data.size()));
+        }
+        ContentPointer pointer;
+        std::memcpy(&pointer.segment, &data[0], 4);
+        std::memcpy(&pointer.offset, &data[4], 8);
+        std::memcpy(&pointer.len, &data[12], 4);
+        std::memcpy(pointer.hash.data(), &data[16], 32);
+        return pointer;
+    }
+};
+
+// Read-only mapping of a segment. Mappings are only unmapped when the segment
+// is closed, so a reader can keep using one after a larger one is published.
+struct SegmentView {
+    const uint8_t* data;
+    size_t length;
+};
+
+// One append-only segment file: magic, dictionary, then records of
+// [compressed_len][raw_len][sha256][zstd frame]. The file is mapped with room
+// to grow up to CONTENT_SEGMENT_MAX_SIZE, so appends rarely need a new
+// mapping; readers only touch the first `readable` bytes.
+class ContentSegment {
+public:
+    uint32_t id;
+    int fd = -1;
+    // Bytes written so far; writer only.
+    uint64_t size = 0;
+    // Bytes readers may access, published after they are written and mapped.
+    std::atomic<uint64_t> readable{0};
+    uint64_t data_start = 0;
+    std::atomic<const SegmentView*> view{nullptr};
+    ZSTD_CDict* cdict = nullptr;
+    ZSTD_DDict* ddict = nullptr;
+
+    ContentSegment(uint32_t id) : id(id) {}
+    ContentSegment(const ContentSegment&) = delete;
+    ContentSegment& operator=(const ContentSegment&) = delete;
+
+    ~ContentSegment() {
+        close();
+    }
+
+    void load_dictionary(const std::vector<uint8_t>& dict) {
+        if (dict.empty()) {
+            return;
+        }
+        cdict = ZSTD_createCDict(dict.data(), dict.size(), CONTENT_COMPRESSION_LEVEL);
+        ddict = ZSTD_createDDict(dict.data(), dict.size());
+    }
+
+    // Makes sure at least `length` bytes are mapped. Writer only.
+    void remap(size_t length) {
+        const SegmentView* current = view.load(std::memory_order_relaxed);
+        if (current != nullptr && current->length >= length) {
+            return;
+        }
+        size_t target = std::max<size_t>(length, CONTENT_SEGMENT_MAX_SIZE);
+        void* addr = mmap(nullptr, target, PROT_READ, MAP_SHARED, fd, 0);
+        if (addr == MAP_FAILED) {
+            throw ContentStoreError("Failed to mmap content segment " + std::to_string(id));
+        }
+        views.push_back(std::make_unique<SegmentView>(SegmentView{static_cast<const uint8_t*>(addr), target}));
+        view.store(views.back().get(), std::memory_order_release);
+    }
+
+    // Exposes everything written so far to readers. Writer only.
+    void publish() {
+        remap(size);
+        readable.store(size, std::memory_order_release);
+    }
+
+    const uint8_t* data() const {
+        return view.load(std::memory_order_acquire)->data;
+    }
+
+    void close() {
+        view.store(nullptr, std::memory_order_relaxed);
+        readable.store(0, std::memory_order_relaxed);
+        for (const auto& mapped : views) {
+            munmap(const_cast<uint8_t*>(mapped->data), mapped->length);
+        }
+        views.clear();
+        if (cdict != nullptr) {
+            ZSTD_freeCDict(cdict);
+            cdict = nullptr;
+        }
+        if (ddict != nullptr) {
+            ZSTD_freeDDict(ddict);
+            ddict = nullptr;
+        }
+        if (fd >= 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+
+private:
+    std::vector<std::unique_ptr<SegmentView>> views;
+};
+
+// Deduplicated, compressed, append-only store for inscription bodies. Bodies
+// are keyed by sha256 so identical content (e.g. BRC-20 mints) is written once.
+// Each segment is compressed with a dictionary trained on bodies sampled while
+// the previous segment was written.
+//
+// The sha256 -> ContentPointer index lives in a KV table; only the entries
+// appended since the last commit() are held in memory. commit() also records
+// the committed size of the last segment, and open() truncates back to it, so
+// anything appended by a block that never committed is discarded.
+//
+// get() is lock-free and may run on any thread: segments are published in a
+// fixed-size table and each reader decompresses with its own context. put()
+// and commit() are serialized by a mutex.
+class ContentStore {
+public:
+    ContentStore() : published(new std::atomic<ContentSegment*>[CONTENT_MAX_SEGMENTS]) {
+        for (uint32_t i = 0; i < CONTENT_MAX_SEGMENTS; i++) {
+            published[i].store(nullptr, std::memory_order_relaxed);
+        }
+    }
+    ContentStore(const ContentStore&) = delete;
+    ContentStore& operator=(const ContentStore&) = delete;
+
+    ~ContentStore() {
+        close();
+    }
+
+    template<typename D>
+    void open(const fs::path& dir, D& index) {
+        this->dir = dir;
+        lookup = [&index](const std::string& key) { return index.get(key); };
+        if (!fs::exists(dir)) {
+            fs::create_directory(dir);
+        }
+        std::optional<std::vector<uint8_t>> tail = index.get(CONTENT_INDEX_TAIL_KEY);
+        if (tail.has_value() && tail->size() == 12) {
+            uint32_t tail_id;
+            uint64_t tail_size;
+            std::memcpy(&tail_id, tail->data(), 4);
+            std::memcpy(&tail_size, tail->data() + 4, 8);
+            for (uint32_t id = 0; id <= tail_id; id++) {
+                if (!fs::exists(segment_path(id))) {
+                    throw ContentStoreError("Content segment " + segment_path(id).string() + " is missing; the content index references "
+                        + std::to_string(tail_id + 1) + " segments. Copy them in before importing a snapshot.");
+                }
+                add_segment(open_segment(id));
+            }
+            // Segments started after the last commit hold nothing referenced.
+            for (uint32_t id = tail_id + 1; fs::exists(segment_path(id)); id++) {
+                fs::remove(segment_path(id));
+            }
+            truncate_segment(*segments.back(), tail_size);
+        } else {
+            // No committed tail: a store written before the index existed.
+            // Verify every record once and stage its hash for the next commit.
+            for (uint32_t id = 0; fs::exists(segment_path(id)); id++) {
+                add_segment(open_segment(id));
+                truncate_segment(*segments.back(), verify_segment(*segments.back()));
+            }
+        }
+        if (segments.empty()) {
+            add_segment(create_segment(0));
+        }
+    }
+
+    ContentPointer put(const std::vector<uint8_t>& body) {
+        std::lock_guard<std::mutex> lock(mutex);
+        libbitcoin::system::hash_digest digest = libbitcoin::system::sha256_hash(body);
+        std::string key(digest.begin(), digest.end());
+        auto found = pending.find(key);
+        if (found != pending.end()) {
+            return found->second;
+        }
+        std::optional<std::vector<uint8_t>> stored = lookup(key);
+        if (stored.has_value()) {
+            return ContentPointer::decode(std::string(stored->begin(), stored->end()));
+        }
+
+        sample(body);
+
+        ContentSegment* segment = segments.back().get();
+        std::vector<uint8_t> record(CONTENT_RECORD_HEADER_SIZE + ZSTD_compressBound(body.size()));
+        size_t compressed_len = compress(*segment, body, record.data() + CONTENT_RECORD_HEADER_SIZE, record.size() - CONTENT_RECORD_HEADER_SIZE);
+        if (segment->size + CONTENT_RECORD_HEADER_SIZE + compressed_len > CONTENT_SEGMENT_MAX_SIZE && segment->size > segment->data_start) {
+            // Only the last segment may have an unsynced tail.
+            if (fdatasync(segment->fd) != 0) {
+                throw ContentStoreError("Failed to sync content segment " + std::to_string(segment->id));
+            }
+            add_segment(create_segment(segment->id + 1));
+            segment = segments.back().get();
+            compressed_len = compress(*segment, body, record.data() + CONTENT_RECORD_HEADER_SIZE, record.size() - CONTENT_RECORD_HEADER_SIZE);
+        }
+
+        uint32_t compressed_len32 = static_cast<uint32_t>(compressed_len);
+        uint32_t raw_len = static_cast<uint32_t>(body.size());
+        std::memcpy(record.data(), &compressed_len32, 4);
+        std::memcpy(record.data() + 4, &raw_len, 4);
+        std::memcpy(record.data() + 8, digest.data(), 32);
+        size_t record_len = CONTENT_RECORD_HEADER_SIZE + compressed_len;
+        if (pwrite(segment->fd, record.data(), record_len, segment->size) != static_cast<ssize_t>(record_len)) {
+            throw ContentStoreError("Failed to append to content segment " + std::to_string(segment->id));
+        }
+
+        ContentPointer pointer;
+        pointer.segment = segment->id;
+        pointer.offset = segment->size;
+        pointer.len = raw_len;
+        std::memcpy(pointer.hash.data(), digest.data(), 32);
+        segment->size += record_len;
+        segment->publish();
+        pending.emplace(key, pointer);
+        return pointer;
+    }
+
+    std::vector<uint8_t> get(const ContentPointer& pointer) const {
+        if (pointer.segment >= segment_count.load(std::memory_order_acquire)) {
+            throw ContentStoreError("Unknown content segment " + std::to_string(pointer.segment));
+        }
+        const ContentSegment& segment = *published[pointer.segment].load(std::memory_order_acquire);
+        uint64_t readable = segment.readable.load(std::memory_order_acquire);
+        if (pointer.offset > readable || readable - pointer.offset < CONTENT_RECORD_HEADER_SIZE) {
+            throw ContentStoreError("Content pointer out of range in segment " + std::to_string(pointer.segment));
+        }
+        const uint8_t* record = segment.data() + pointer.offset;
+        uint32_t compressed_len;
+        std::memcpy(&compressed_len, record, 4);
+        if (compressed_len > readable - pointer.offset - CONTENT_RECORD_HEADER_SIZE) {
+            throw ContentStoreError("Content record overruns segment " + std::to_string(pointer.segment));
+        }
+
+        std::vector<uint8_t> body(pointer.len);
+        size_t n = decompress(segment, record + CONTENT_RECORD_HEADER_SIZE, compressed_len, body);
+        if (ZSTD_isError(n) || n != pointer.len) {
+            throw ContentStoreError("Corrupted content record at " + std::to_string(pointer.segment) + ":" + std::to_string(pointer.offset));
+        }
+        return body;
+    }
+
+    // Makes content appended since the last commit durable and indexes it.
+    // Call before committing the KV batch that references it.
+    template<typename D>
+    void commit(D& index) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (pending.empty()) {
+            return;
+        }
+        ORDI_KILL_POINT("content_store.before_sync");
+        ContentSegment& segment = *segments.back();
+        if (fdatasync(segment.fd) != 0) {
+            throw ContentStoreError("Failed to sync content segment " + std::to_string(segment.id));
+        }
+        WriteBatch wb;
+        for (const auto& entry : pending) {
+            wb.put(entry.first, entry.second.encode());
+        }
+        std::string tail(12, '\0');
+        std::memcpy(&tail[0], &segment.id, 4);
+        std::memcpy(&tail[4], &segment.size, 8);
+        wb.put(CONTENT_INDEX_TAIL_KEY, tail);
+        // Synced so the tail never lags a status commit that follows it.
+        index.write(wb, true);
+        pending.clear();
+    }
+
+    // Readers must be stopped first.
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        segment_count.store(0, std::memory_order_release);
+        for (const auto& segment : segments) {
+            published[segment->id].store(nullptr, std::memory_order_relaxed);
+        }
+        segments.clear();
+        pending.clear();
+        if (cctx_ != nullptr) {
+            ZSTD_freeCCtx(cctx_);
+            cctx_ = nullptr;
+        }
+    }
+
+private:
+    fs::path dir;
+    // Owned by the writer; readers go through `published` instead.
+    std::vector<std::unique_ptr<ContentSegment>> segments;
+    std::unique_ptr<std::atomic<ContentSegment*>[]> published;
+    std::atomic<uint32_t> segment_count{0};
+    std::function<std::optional<std::vector<uint8_t>>(const std::string&)> lookup;
+    // Appended since the last commit, keyed by sha256.
+    std::unordered_map<std::string, ContentPointer> pending;
+    std::deque<std::vector<uint8_t>> samples;
+    size_t sample_bytes = 0;
+    ZSTD_CCtx* cctx_ = nullptr;
+    std::mutex mutex;
+
+    fs::path segment_path(uint32_t id) const {
+        char name[32];
+        std::snprintf(name, sizeof(name), "seg-%06u.dat", id);
+        return dir / name;
+    }
+
+    ZSTD_CCtx* cctx() {
+        if (cctx_ == nullptr) {
+            cctx_ = ZSTD_createCCtx();
+        }
+        return cctx_;
+    }
+
+    // One decompression context per thread, so readers never share one.
+    static ZSTD_DCtx* dctx() {
+        struct ThreadDCtx {
+            ZSTD_DCtx* ctx = ZSTD_createDCtx();
+            ~ThreadDCtx() {
+                ZSTD_freeDCtx(ctx);
+            }
+        };
+        thread_local ThreadDCtx thread_dctx;
+        return thread_dctx.ctx;
+    }
+
+    static size_t decompress(const ContentSegment& segment, const uint8_t* frame, size_t frame_len, std::vector<uint8_t>& body) {
+        if (segment.ddict != nullptr) {
+            return ZSTD_decompress_usingDDict(dctx(), body.data(), body.size(), frame, frame_len, segment.ddict);
+        }
+        return ZSTD_decompressDCtx(dctx(), body.data(), body.size(), frame, frame_len);
+    }
+
+    // Segments are published in id order before any pointer into them exists.
+    void add_segment(std::unique_ptr<ContentSegment> segment) {
+        if (segment->id >= CONTENT_MAX_SEGMENTS) {
+            throw ContentStoreError("Too many content segments in " + dir.string());
+        }
+        published[segment->id].store(segment.get(), std::memory_order_release);
+        segments.push_back(std::move(segment));
+        segment_count.store(static_cast<uint32_t>(segments.size()), std::memory_order_release);
+    }
+
+    size_t compress(ContentSegment& segment, const std::vector<uint8_t>& body, uint8_t* out, size_t capacity) {
+        size_t n;
+        if (segment.cdict != nullptr) {
+            n = ZSTD_compress_usingCDict(cctx(), out, capacity, body.data(), body.size(), segment.cdict);
+        } else {
+            n = ZSTD_compressCCtx(cctx(), out, capacity, body.data(), body.size(), CONTENT_COMPRESSION_LEVEL);
+        }
+        if (ZSTD_isError(n)) {
+            throw ContentStoreError(std::string("Failed to compress content: ") + ZSTD_getErrorName(n));
+        }
+        return n;
+    }
+
+    void sample(const std::vector<uint8_t>& body) {
+        if (body.empty() || body.size() > CONTENT_DICT_MAX_SAMPLE_SIZE) {
+            return;
+        }
+        samples.push_back(body);
+        sample_bytes += body.size();
+        while (samples.size() > CONTENT_DICT_MAX_SAMPLES || sample_bytes > CONTENT_DICT_MAX_SAMPLE_BYTES) {
+            sample_bytes -= samples.front().size();
+            samples.pop_front();
+        }
+    }
+
+    std::vector<uint8_t> train_dictionary() {
+        std::vector<uint8_t> dict;
+        if (samples.size() < 8) {
+            return dict;
+        }
+        std::vector<uint8_t> buffer;
+        std::vector<size_t> sizes;
+        buffer.reserve(sample_bytes);
+        for (const auto& s : samples) {
+            buffer.insert(buffer.end(), s.begin(), s.end());
+            sizes.push_back(s.size());
+        }
+        dict.resize(CONTENT_DICT_SIZE);
+        size_t n = ZDICT_trainFromBuffer(dict.data(), dict.size(), buffer.data(), sizes.data(), static_cast<unsigned>(sizes.size()));
+        if (ZDICT_isError(n)) {
+            dict.clear();
+        } else {
+            dict.resize(n);
+        }
+        return dict;
+    }
+
+    std::unique_ptr<ContentSegment> create_segment(uint32_t id) {
+        std::vector<uint8_t> dict = train_dictionary();
+        auto segment = std::make_unique<ContentSegment>(id);
+        segment->fd = ::open(segment_path(id).c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+        if (segment->fd < 0) {
+            throw ContentStoreError("Failed to create content segment: " + segment_path(id).string());
+        }
+        uint32_t dict_len = static_cast<uint32_t>(dict.size());
+        std::vector<uint8_t> header(sizeof(CONTENT_SEGMENT_MAGIC) + 4 + dict.size());
+        std::memcpy(header.data(), CONTENT_SEGMENT_MAGIC, sizeof(CONTENT_SEGMENT_MAGIC));
+        std::memcpy(header.data() + sizeof(CONTENT_SEGMENT_MAGIC), &dict_len, 4);
+        if (!dict.empty()) {
+            std::memcpy(header.data() + sizeof(CONTENT_SEGMENT_MAGIC) + 4, dict.data(), dict.size());
+        }
+        if (pwrite(segment->fd, header.data(), header.size(), 0) != static_cast<ssize_t>(header.size())) {
+            throw ContentStoreError("Failed to write content segment header: " + segment_path(id).string());
+        }
+        fdatasync(segment->fd);
+        segment->size = header.size();
+        segment->data_start = header.size();
+        segment->load_dictionary(dict);
+        segment->publish();
+        return segment;
+    }
+
+    std::unique_ptr<ContentSegment> open_segment(uint32_t id) {
+        auto segment = std::make_unique<ContentSegment>(id);
+        segment->fd = ::open(segment_path(id).c_str(), O_RDWR);
+        if (segment->fd < 0) {
+            throw ContentStoreError("Failed to open content segment: " + segment_path(id).string());
+        }
+        struct stat st;
+        fstat(segment->fd, &st);
+        segment->size = static_cast<uint64_t>(st.st_size);
+        segment->publish();
+
+        size_t prefix = sizeof(CONTENT_SEGMENT_MAGIC) + 4;
+        const uint8_t* data = segment->data();
+        if (segment->size < prefix || std::memcmp(data, CONTENT_SEGMENT_MAGIC, sizeof(CONTENT_SEGMENT_MAGIC)) != 0) {
+            throw ContentStoreError("Invalid content segment header: " + segment_path(id).string());
+        }
+        uint32_t dict_len;
+        std::memcpy(&dict_len, data + sizeof(CONTENT_SEGMENT_MAGIC), 4);
+        if (dict_len > segment->size - prefix) {
+            throw ContentStoreError("Truncated content segment dictionary: " + segment_path(id).string());
+        }
+        segment->load_dictionary(std::vector<uint8_t>(data + prefix, data + prefix + dict_len));
+        segment->data_start = prefix + dict_len;
+        return segment;
+    }
+
+    // Returns the end of the last record whose body decompresses to its
+    // stored sha256, staging each such record in the index. A torn or
+    // zero-filled tail fails the check and is cut off.
+    uint64_t verify_segment(ContentSegment& segment) {
+        uint64_t offset = segment.data_start;
+        std::vector<uint8_t> body;
+        const uint8_t* data = segment.data();
+        while (offset + CONTENT_RECORD_HEADER_SIZE <= segment.size) {
+            const uint8_t* record = data + offset;
+            uint32_t compressed_len, raw_len;
+            std::memcpy(&compressed_len, record, 4);
+            std::memcpy(&raw_len, record + 4, 4);
+            if (compressed_len == 0 || compressed_len > segment.size - offset - CONTENT_RECORD_HEADER_SIZE) {
+                break;
+            }
+            body.resize(raw_len);
+            size_t n = decompress(segment, record + CONTENT_RECORD_HEADER_SIZE, compressed_len, body);
+            if (ZSTD_isError(n) || n != raw_len) {
+                break;
+            }
+            libbitcoin::system::hash_digest digest = libbitcoin::system::sha256_hash(body);
+            if (std::memcmp(digest.data(), record + 8, 32) != 0) {
+                break;
+            }
+            ContentPointer pointer;
+            pointer.segment = segment.id;
+            pointer.offset = offset;
+            pointer.len = raw_len;
+            std::memcpy(pointer.hash.data(), digest.data(), 32);
+            pending.emplace(std::string(digest.begin(), digest.end()), pointer);
+            offset += CONTENT_RECORD_HEADER_SIZE + compressed_len;
+        }
+        return offset;
+    }
+
+    void truncate_segment(ContentSegment& segment, uint64_t size) {
+        if (size == segment.size) {
+            return;
+        }
+        if (size > segment.size || size < segment.data_start) {
+            throw ContentStoreError("Content segment " + std::to_string(segment.id) + " is shorter than its committed size");
+        }
+        std::cout << "Truncating content segment " << segment.id << " from " << segment.size << " to " << size << "." << std::endl;
+        if (ftruncate(segment.fd, size) != 0) {
+            throw ContentStoreError("Failed to truncate content segment " + std::to_string(segment.id));
+        }
+        segment.size = size;
+        segment.readable.store(size, std::memory_order_release);
+    }
+};
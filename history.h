@@ -0,0 +1,231 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <optional>
+#include <algorithm>
+#include <cstdint>
+#include "varint.h"
+
+// Events per chunk before a new chunk is started. Only the tail chunk of an
+// address is ever rewritten, so appends stay small.
+const size_t HISTORY_CHUNK_EVENTS = 128;
+
+enum class HistoryEventType : uint8_t {
+    Inscribe = 1,
+    InscriptionReceived = 2,
+    InscriptionSent = 3,
+    Brc20Deploy = 4,
+    Brc20Mint = 5,
+    Brc20TransferInscribed = 6,
+    Brc20TransferReceived = 7,
+    Brc20TransferSent = 8,
+};
+
+struct HistoryEvent {
+    uint32_t height;
+    uint32_t tx_index;
+    HistoryEventType type;
+    // Inscription sequence number or interned ticker id, depending on type.
+    uint64_t ref;
+};
+
+// Per-address activity index over interned address ids. Each address has a
+// posting list of events in (height, tx_index) order, split into chunks of
+// at most HISTORY_CHUNK_EVENTS:
+//   'c'<addr BE4><first height BE4><chunk seq BE4> -> chunk
+//   't'<addr BE4>                                  -> key suffix of the tail chunk
+// A chunk is varint(count) followed by, per event, varint(height delta),
+// varint(tx_index, delta-coded within the same height), type, varint(ref).
+class HistoryIndex {
+public:
+    void add(uint32_t address_id, const HistoryEvent& event) {
+        staged[address_id].push_back(event);
+    }
+
+    // Drops events staged by a block that failed before commit().
+    void clear_staged() {
+        staged.clear();
+    }
+
+    // Appends the events staged for this block. Call once per block, after
+    // the interner has been committed. Re-committing a height that already
+    // reached the history table is a no-op.
+    template<typename D>
+    void commit(D& history) {
+        if (staged.empty()) {
+            return;
+        }
+        WriteBatch wb;
+        for (auto& entry : staged) {
+            uint32_t address_id = entry.first;
+            std::vector<HistoryEvent>& events = entry.second;
+            std::stable_sort(events.begin(), events.end(), [](const HistoryEvent& a, const HistoryEvent& b) {
+                return a.height != b.height ? a.height < b.height : a.tx_index < b.tx_index;
+            });
+
+            std::vector<HistoryEvent> tail;
+            uint32_t seq = 0;
+            std::optional<std::vector<uint8_t>> tail_suffix = history.get(tail_key(address_id));
+            if (tail_suffix.has_value()) {
+                std::string suffix(tail_suffix->begin(), tail_suffix->end());
+                seq = get_be32(suffix, 4);
+                std::optional<std::vector<uint8_t>> chunk = history.get(chunk_prefix(address_id) + suffix);
+                if (chunk.has_value()) {
+                    tail = decode_chunk(std::string(chunk->begin(), chunk->end()));
+                }
+            }
+            // A block replayed after a crash finds its own events already in
+            // the tail; appending them again would duplicate them.
+            if (!tail.empty()) {
+                uint32_t last_height = tail.back().height;
+                events.erase(std::remove_if(events.begin(), events.end(), [last_height](const HistoryEvent& event) {
+                    return event.height <= last_height;
+                }), events.end());
+            }
+
+            size_t next = 0;
+            while (next < events.size()) {
+                if (tail.size() >= HISTORY_CHUNK_EVENTS) {
+                    tail.clear();
+                    seq++;
+                }
+                size_t take = std::min(HISTORY_CHUNK_EVENTS - tail.size(), events.size() - next);
+                tail.insert(tail.end(), events.begin() + next, events.begin() + next + take);
+                next += take;
+                // The sequence keeps keys unique when several chunks start at one height.
+                std::string suffix = position(tail.front().height, seq);
+                wb.put(chunk_prefix(address_id) + suffix, encode_chunk(tail));
+                wb.put(tail_key(address_id), suffix);
+            }
+        }
+        history.write(wb, false);
+        staged.clear();
+    }
+
+    // Events of `address_id` with from_height <= height <= to_height. Only
+    // chunks overlapping the range are read and decoded.
+    template<typename D>
+    std::vector<HistoryEvent> query(D& history, uint32_t address_id, uint32_t from_height, uint32_t to_height) {
+        std::vector<HistoryEvent> result;
+        std::optional<std::vector<uint8_t>> tail_suffix = history.get(tail_key(address_id));
+        if (!tail_suffix.has_value() || from_height > to_height) {
+            return result;
+        }
+        std::string prefix = chunk_prefix(address_id);
+        std::string start = prefix + position(from_height, 0);
+        std::string tail = prefix + std::string(tail_suffix->begin(), tail_suffix->end());
+
+        auto iter = history.new_iter();
+        std::vector<uint8_t> key, value;
+        if (tail <= start) {
+            // Only the tail chunk can hold events at or after from_height.
+            iter.seek(tail);
+        } else {
+            iter.seek(start);
+            iter.current(key, value);
+            if (std::string(key.begin(), key.end()) != start && iter.prev()) {
+                iter.current(key, value);
+                if (std::string(key.begin(), key.end()).compare(0, prefix.size(), prefix) != 0) {
+                    iter.seek(start);
+                }
+            }
+        }
+
+        while (iter.current(key, value)) {
+            std::string k(key.begin(), key.end());
+            if (k.compare(0, prefix.size(), prefix) != 0 || chunk_first_height(k) > to_height) {
+                break;
+            }
+            for (const HistoryEvent& event : decode_chunk(std::string(value.begin(), value.end()))) {
+                if (event.height >= from_height && event.height <= to_height) {
+                    result.push_back(event);
+                }
+            }
+            if (!iter.advance()) {
+                break;
+            }
+        }
+        return result;
+    }
+
+    static std::string encode_chunk(const std::vector<HistoryEvent>& events) {
+        std::string out;
+        put_varint(out, events.size());
+        uint32_t height = 0, tx_index = 0;
+        for (const HistoryEvent& event : events) {
+            put_varint(out, event.height - height);
+            put_varint(out, event.height == height ? event.tx_index - tx_index : event.tx_index);
+            out.push_back(static_cast<char>(event.type));
+            put_varint(out, event.ref);
+            height = event.height;
+            tx_index = event.tx_index;
+        }
+        return out;
+    }
+
+    static std::vector<HistoryEvent> decode_chunk(const std::string& chunk) {
+        size_t pos = 0;
+        uint64_t count = get_varint(chunk, pos);
+        std::vector<HistoryEvent> events;
+        events.reserve(count);
+        uint32_t height = 0, tx_index = 0;
+        for (uint64_t i = 0; i < count; i++) {
+            uint32_t height_delta = static_cast<uint32_t>(get_varint(chunk, pos));
+            uint32_t tx = static_cast<uint32_t>(get_varint(chunk, pos));
+            if (pos >= chunk.size()) {
+                throw std::runtime_error("truncated history chunk");
+            }
+            HistoryEvent event;
+            event.height = height + height_delta;
+            event.tx_index = height_delta == 0 ? tx_index + tx : tx;
+            event.type = static_cast<HistoryEventType>(chunk[pos++]);
+            event.ref = get_varint(chunk, pos);
+            events.push_back(event);
+            height = event.height;
+            tx_index = event.tx_index;
+        }
+        return events;
+    }
+
+private:
+    std::map<uint32_t, std::vector<HistoryEvent>> staged;
+
+    static void put_be32(std::string& out, uint32_t n) {
+        out.push_back(static_cast<char>(n >> 24));
+        out.push_back(static_cast<char>(n >> 16));
+        out.push_back(static_cast<char>(n >> 8));
+        out.push_back(static_cast<char>(n));
+    }
+
+    static uint32_t get_be32(const std::string& in, size_t pos) {
+        return (static_cast<uint32_t>(static_cast<uint8_t>(in[pos])) << 24)
+            | (static_cast<uint32_t>(static_cast<uint8_t>(in[pos + 1])) << 16)
+            | (static_cast<uint32_t>(static_cast<uint8_t>(in[pos + 2])) << 8)
+            | static_cast<uint32_t>(static_cast<uint8_t>(in[pos + 3]));
+    }
+
+    static std::string chunk_prefix(uint32_t address_id) {
+        std::string key(1, 'c');
+        put_be32(key, address_id);
+        return key;
+    }
+
+    static std::string tail_key(uint32_t address_id) {
+        std::string key(1, 't');
+        put_be32(key, address_id);
+        return key;
+    }
+
+    static std::string position(uint32_t height, uint32_t seq) {
+        std::string out;
+        put_be32(out, height);
+        put_be32(out, seq);
+        return out;
+    }
+
+    static uint32_t chunk_first_height(const std::string& key) {
+        return get_be32(key, 5);
+    }
+};
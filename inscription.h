@@ -1,3 +1,5 @@
+#pragma once
+
 #include <iostream>
 #include <vector>
 #include <array>
@@ -8,6 +10,7 @@
 #include <bitcoin/system.hpp>
 #include <bitcoin/taproot.hpp>
 #include "block.hpp"
+#include "transaction_inscription.h"
 
 enum class Curse {
     NotInFirstInput,
@@ -20,17 +23,6 @@ public:
     InscriptionError(const std::string& message) : std::runtime_error(message) {}
 };
 
-struct Inscription {
-    std::optional<std::vector<uint8_t>> body;
-    std::optional<std::vector<uint8_t>> content_type;
-};
-
-struct TransactionInscription {
-    Inscription inscription;
-    uint32_t tx_in_index;
-    uint32_t tx_in_offset;
-};
-
 class InscriptionParser {
 public:
     std::vector<std::result<Inscription>> parseInscriptions() {
@@ -135,6 +127,8 @@ public:
 
 private:
     std::vector<Instruction> instructions;
+
+public:
     static std::vector<TransactionInscription> from_transaction(const Tx& tx) {
         std::vector<TransactionInscription> result;
         for (size_t index = 0; index < tx.inputs.size(); ++index) {
@@ -187,4 +181,8 @@ private:
         }
         return inscriptions;
     }
-};
\ No newline at end of file
+};
+
+inline std::vector<TransactionInscription> inscriptions_of(const Tx& tx) {
+    return InscriptionParser::from_transaction(tx);
+}
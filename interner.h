@@ -0,0 +1,222 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <functional>
+#include <cstdint>
+#include <cstring>
+
+const size_t INTERNER_CHUNK_BITS = 16;
+const size_t INTERNER_CHUNK_SIZE = 1 << INTERNER_CHUNK_BITS;
+const size_t INTERNER_MAX_CHUNKS = 1 << 16;
+const size_t INTERNER_MIN_SLOTS = 1 << 16;
+
+class InternerError : public std::exception {
+public:
+    InternerError(const std::string& message) : message(message) {}
+    const char* what() const noexcept override {
+        return message.c_str();
+    }
+private:
+    std::string message;
+};
+
+// Dictionary from byte strings (scriptPubkeys, tickers) to dense uint32 ids so
+// hot-path state can be keyed by fixed-width integers.
+//
+// There is a single writer (the indexing thread). Readers on any thread use
+// find() and resolve() without locks: values live in append-only chunks and
+// the open-addressing table is replaced wholesale on growth, with retired
+// tables kept alive until the interner is destroyed.
+//
+// Persisted in the dictionary table under a one byte namespace as
+//   <ns>'i'<id, BE>     -> value
+// and reloaded in id order on startup; lookups by value are served from
+// memory only, so no reverse key is stored.
+class Interner {
+public:
+    Interner(char ns) : ns(ns), chunks(new std::atomic<std::string*>[INTERNER_MAX_CHUNKS]) {
+        for (size_t i = 0; i < INTERNER_MAX_CHUNKS; i++) {
+            chunks[i].store(nullptr, std::memory_order_relaxed);
+        }
+        table.store(new Table(INTERNER_MIN_SLOTS), std::memory_order_release);
+    }
+    Interner(const Interner&) = delete;
+    Interner& operator=(const Interner&) = delete;
+
+    ~Interner() {
+        delete table.load();
+        for (Table* retired_table : retired) {
+            delete retired_table;
+        }
+        for (size_t i = 0; i < INTERNER_MAX_CHUNKS; i++) {
+            delete[] chunks[i].load();
+        }
+    }
+
+    template<typename D>
+    void load(D& dictionary) {
+        auto iter = dictionary.new_iter();
+        std::vector<uint8_t> key, value;
+        uint32_t loaded = 0;
+        while (iter.advance()) {
+            iter.current(key, value);
+            if (key.size() != 6 || key[0] != static_cast<uint8_t>(ns) || key[1] != 'i') {
+                continue;
+            }
+            uint32_t id = decode_id(&key[2]);
+            if (id != count.load(std::memory_order_relaxed)) {
+                throw InternerError("Dictionary ids are not dense at " + std::to_string(id));
+            }
+            append(std::string(value.begin(), value.end()));
+            loaded++;
+        }
+        std::cout << "Loaded " << loaded << " interned values for namespace '" << ns << "'." << std::endl;
+    }
+
+    // Lock-free lookup; false when the value has not been interned.
+    bool find(const std::string& value, uint32_t& id) const {
+        const Table* t = table.load(std::memory_order_acquire);
+        size_t hash = std::hash<std::string>()(value);
+        for (size_t i = hash & t->mask; ; i = (i + 1) & t->mask) {
+            uint32_t slot = t->slots[i].load(std::memory_order_acquire);
+            if (slot == 0) {
+                return false;
+            }
+            if (resolve(slot - 1) == value) {
+                id = slot - 1;
+                return true;
+            }
+        }
+    }
+
+    // Lock-free; id must have been returned by find() or intern().
+    const std::string& resolve(uint32_t id) const {
+        return chunks[id >> INTERNER_CHUNK_BITS].load(std::memory_order_acquire)[id & (INTERNER_CHUNK_SIZE - 1)];
+    }
+
+    // Writer only. New entries are queued for commit().
+    uint32_t intern(const std::string& value) {
+        uint32_t id;
+        if (find(value, id)) {
+            return id;
+        }
+        id = append(value);
+        pending.put(prefix('i') + encode_id(id), value);
+        pending_count++;
+        return id;
+    }
+
+    // Persists entries interned since the last commit. Call before writing
+    // any table that stores the new ids.
+    template<typename D>
+    void commit(D& dictionary) {
+        if (pending_count == 0) {
+            return;
+        }
+        dictionary.write(pending, true);
+        pending = WriteBatch();
+        pending_count = 0;
+    }
+
+    uint32_t size() const {
+        return count.load(std::memory_order_acquire);
+    }
+
+    // Writer only, like intern().
+    size_t memory_usage() const {
+        size_t bytes = INTERNER_MAX_CHUNKS * sizeof(std::atomic<std::string*>);
+        bytes += table.load()->capacity() * sizeof(uint32_t);
+        for (const Table* retired_table : retired) {
+            bytes += retired_table->capacity() * sizeof(uint32_t);
+        }
+        uint32_t n = size();
+        bytes += ((n + INTERNER_CHUNK_SIZE - 1) >> INTERNER_CHUNK_BITS) * INTERNER_CHUNK_SIZE * sizeof(std::string);
+        return bytes + heap_bytes;
+    }
+
+private:
+    struct Table {
+        size_t mask;
+        std::unique_ptr<std::atomic<uint32_t>[]> slots;
+
+        Table(size_t capacity) : mask(capacity - 1), slots(new std::atomic<uint32_t>[capacity]) {
+            for (size_t i = 0; i < capacity; i++) {
+                slots[i].store(0, std::memory_order_relaxed);
+            }
+        }
+
+        size_t capacity() const {
+            return mask + 1;
+        }
+
+        void insert(size_t hash, uint32_t id) {
+            size_t i = hash & mask;
+            while (slots[i].load(std::memory_order_relaxed) != 0) {
+                i = (i + 1) & mask;
+            }
+            slots[i].store(id + 1, std::memory_order_release);
+        }
+    };
+
+    char ns;
+    std::unique_ptr<std::atomic<std::string*>[]> chunks;
+    std::atomic<Table*> table;
+    std::vector<Table*> retired;
+    std::atomic<uint32_t> count{0};
+    WriteBatch pending;
+    size_t pending_count = 0;
+    // Buffers of values too long for the small string optimization.
+    size_t heap_bytes = 0;
+
+    std::string prefix(char kind) const {
+        return std::string(1, ns) + kind;
+    }
+
+    static std::string encode_id(uint32_t id) {
+        std::string out(4, '\0');
+        out[0] = static_cast<char>(id >> 24);
+        out[1] = static_cast<char>(id >> 16);
+        out[2] = static_cast<char>(id >> 8);
+        out[3] = static_cast<char>(id);
+        return out;
+    }
+
+    static uint32_t decode_id(const uint8_t* data) {
+        return (static_cast<uint32_t>(data[0]) << 24) | (static_cast<uint32_t>(data[1]) << 16) | (static_cast<uint32_t>(data[2]) << 8) | data[3];
+    }
+
+    uint32_t append(const std::string& value) {
+        uint32_t id = count.load(std::memory_order_relaxed);
+        if (id == UINT32_MAX || (id >> INTERNER_CHUNK_BITS) >= INTERNER_MAX_CHUNKS) {
+            throw InternerError(std::string("Interner namespace '") + ns + "' is full.");
+        }
+        std::string* chunk = chunks[id >> INTERNER_CHUNK_BITS].load(std::memory_order_relaxed);
+        if (chunk == nullptr) {
+            chunk = new std::string[INTERNER_CHUNK_SIZE];
+            chunks[id >> INTERNER_CHUNK_BITS].store(chunk, std::memory_order_release);
+        }
+        std::string& stored = chunk[id & (INTERNER_CHUNK_SIZE - 1)];
+        stored = value;
+        if (stored.capacity() > std::string().capacity()) {
+            heap_bytes += stored.capacity() + 1;
+        }
+        count.store(id + 1, std::memory_order_release);
+
+        Table* t = table.load(std::memory_order_relaxed);
+        if ((id + 1) * 2 > t->capacity()) {
+            Table* grown = new Table(t->capacity() * 2);
+            for (uint32_t i = 0; i <= id; i++) {
+                grown->insert(std::hash<std::string>()(resolve(i)), i);
+            }
+            table.store(grown, std::memory_order_release);
+            retired.push_back(t);
+        } else {
+            t->insert(std::hash<std::string>()(value), id);
+        }
+        return id;
+    }
+};
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <string>
+#include <cstdlib>
+#include <cstdint>
+#include <csignal>
+#include <unistd.h>
+
+// Deterministic crash injection for the recovery benchmark. With
+// ordi_kill_at=<name>:<n> in the environment the process SIGKILLs itself on
+// the n-th time it reaches kill point <name> (1-based); otherwise every kill
+// point is a single predictable branch.
+class KillPoints {
+public:
+    static KillPoints& instance() {
+        static KillPoints points;
+        return points;
+    }
+
+    void reach(const char* name) {
+        if (!armed || target != name) {
+            return;
+        }
+        if (++hits == nth) {
+            kill(getpid(), SIGKILL);
+        }
+    }
+
+private:
+    bool armed = false;
+    std::string target;
+    uint64_t nth = 0;
+    uint64_t hits = 0;
+
+    KillPoints() {
+        const char* spec = std::getenv("ordi_kill_at");
+        if (spec == nullptr) {
+            return;
+        }
+        std::string s(spec);
+        size_t colon = s.rfind(':');
+        target = s.substr(0, colon);
+        nth = colon == std::string::npos ? 1 : std::stoull(s.substr(colon + 1));
+        armed = nth > 0;
+    }
+};
+
+#define ORDI_KILL_POINT(name) KillPoints::instance().reach(name)
@@ -0,0 +1,279 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <algorithm>
+#include <cstdint>
+#include <unistd.h>
+
+// Anything whose footprint the governor can resize at runtime.
+class MemoryConsumer {
+public:
+    virtual ~MemoryConsumer() {}
+    virtual size_t memory_usage() const = 0;
+    virtual void set_memory_limit(size_t bytes) = 0;
+    virtual uint64_t hits() const { return 0; }
+    virtual uint64_t misses() const { return 0; }
+};
+
+inline size_t cache_entry_size(const std::string& s) {
+    return sizeof(std::string) + s.capacity();
+}
+
+inline size_t cache_entry_size(uint64_t) {
+    return sizeof(uint64_t);
+}
+
+// LRU cache bounded by approximate bytes rather than entry count, so the
+// governor can hand it an exact share of the budget.
+template<typename K, typename V>
+class BoundedCache : public MemoryConsumer {
+public:
+    // Per-entry overhead of the list node plus the hash map node.
+    static const size_t ENTRY_OVERHEAD = 96;
+
+    bool get(const K& key, V& value) {
+        auto found = map.find(key);
+        if (found == map.end()) {
+            miss_count++;
+            return false;
+        }
+        hit_count++;
+        entries.splice(entries.begin(), entries, found->second);
+        value = found->second->second;
+        return true;
+    }
+
+    void put(const K& key, const V& value) {
+        auto found = map.find(key);
+        if (found != map.end()) {
+            usage -= cost(found->second->first, found->second->second);
+            found->second->second = value;
+            usage += cost(key, value);
+            entries.splice(entries.begin(), entries, found->second);
+        } else {
+            entries.emplace_front(key, value);
+            map.emplace(key, entries.begin());
+            usage += cost(key, value);
+        }
+        evict();
+    }
+
+    void erase(const K& key) {
+        auto found = map.find(key);
+        if (found == map.end()) {
+            return;
+        }
+        usage -= cost(found->second->first, found->second->second);
+        entries.erase(found->second);
+        map.erase(found);
+    }
+
+    size_t memory_usage() const override {
+        return usage;
+    }
+
+    void set_memory_limit(size_t bytes) override {
+        limit = bytes;
+        evict();
+    }
+
+    uint64_t hits() const override {
+        return hit_count;
+    }
+
+    uint64_t misses() const override {
+        return miss_count;
+    }
+
+private:
+    std::list<std::pair<K, V>> entries;
+    std::unordered_map<K, typename std::list<std::pair<K, V>>::iterator> map;
+    size_t usage = 0;
+    size_t limit = 0;
+    uint64_t hit_count = 0;
+    uint64_t miss_count = 0;
+
+    static size_t cost(const K& key, const V& value) {
+        return cache_entry_size(key) + cache_entry_size(value) + ENTRY_OVERHEAD;
+    }
+
+    void evict() {
+        while (usage > limit && !entries.empty()) {
+            auto& last = entries.back();
+            usage -= cost(last.first, last.second);
+            map.erase(last.first);
+            entries.pop_back();
+        }
+    }
+};
+
+// Memory limit of the process's cgroup (v2 memory.max, else v1
+// memory.limit_in_bytes); 0 when there is none.
+inline size_t cgroup_memory_limit() {
+    const char* paths[] = {"/sys/fs/cgroup/memory.max", "/sys/fs/cgroup/memory/memory.limit_in_bytes"};
+    for (const char* path : paths) {
+        std::ifstream file(path);
+        std::string value;
+        if (!(file >> value) || value == "max") {
+            continue;
+        }
+        try {
+            return static_cast<size_t>(std::stoull(value));
+        } catch (const std::exception&) {
+            continue;
+        }
+    }
+    return 0;
+}
+
+// Physical RAM, capped by the cgroup limit so containers size to their quota.
+inline size_t physical_memory() {
+    size_t physical = static_cast<size_t>(sysconf(_SC_PHYS_PAGES)) * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t limit = cgroup_memory_limit();
+    return limit > 0 && limit < physical ? limit : physical;
+}
+
+// Anonymous resident memory (heap, arenas, caches). File-backed pages such
+// as the content segment and blk mmaps are left out: the kernel can drop them
+// at will, so they say nothing about pressure on the budget.
+inline size_t anonymous_memory() {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 8, "RssAnon:") == 0) {
+            return static_cast<size_t>(std::stoull(line.substr(8))) << 10;
+        }
+    }
+    // Kernels before 4.5 lack RssAnon; resident minus shared pages is close.
+    std::ifstream statm("/proc/self/statm");
+    size_t pages = 0, resident = 0, shared = 0;
+    if (!(statm >> pages >> resident >> shared) || shared > resident) {
+        return 0;
+    }
+    return (resident - shared) * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+// Shares a single RSS budget between fixed reservations (LevelDB block cache
+// and memtables, the block index, the outpoint filter, the block arena) and
+// resizable consumers (UTXO and inscription caches). rebalance() moves the
+// resizable part towards consumers that are missing more, and shrinks all of
+// them when the process's anonymous RSS exceeds the budget.
+class MemoryGovernor {
+public:
+    // Fraction of the budget given to the shared LevelDB block cache.
+    static constexpr double BLOCK_CACHE_FRACTION = 0.25;
+    // Fraction of the budget split between the LevelDB memtables, counting
+    // the immutable memtable each table can hold while it is compacted.
+    static constexpr double MEMTABLE_FRACTION = 0.10;
+    // Weight of the newest target when smoothing limits between rounds.
+    static constexpr double SMOOTHING = 0.25;
+
+    MemoryGovernor() {}
+
+    void set_budget(size_t bytes) {
+        budget = bytes == 0 ? physical_memory() / 2 : bytes;
+        std::cout << "Memory budget: " << (budget >> 20) << "MB." << std::endl;
+    }
+
+    size_t get_budget() const {
+        return budget;
+    }
+
+    size_t block_cache_size() const {
+        return static_cast<size_t>(budget * BLOCK_CACHE_FRACTION);
+    }
+
+    // write_buffer_size for each of `db_count` tables; reserve twice this
+    // per table.
+    size_t memtable_size(size_t db_count) const {
+        return std::max<size_t>(static_cast<size_t>(budget * MEMTABLE_FRACTION) / (2 * db_count), 4 << 20);
+    }
+
+    // Records memory that is not resizable at runtime. Calling again with the
+    // same name updates the reservation.
+    void reserve(const std::string& name, size_t bytes) {
+        reserved[name] = bytes;
+    }
+
+    void add(const std::string& name, MemoryConsumer* consumer, size_t min_bytes, double weight) {
+        Share share;
+        share.name = name;
+        share.consumer = consumer;
+        share.min = min_bytes;
+        share.weight = weight;
+        shares.push_back(share);
+        rebalance();
+    }
+
+    void rebalance() {
+        size_t fixed = 0;
+        for (const auto& r : reserved) {
+            fixed += r.second;
+        }
+        size_t minimum = 0;
+        for (const auto& share : shares) {
+            minimum += share.min;
+        }
+        size_t pool = budget > fixed + minimum ? budget - fixed - minimum : 0;
+
+        size_t rss = anonymous_memory();
+        if (rss > budget && rss > 0) {
+            // Under pressure: shrink the resizable pool proportionally.
+            pool = static_cast<size_t>(pool * 0.9 * static_cast<double>(budget) / rss);
+        }
+
+        std::vector<double> scores(shares.size());
+        double total = 0;
+        for (size_t i = 0; i < shares.size(); i++) {
+            Share& share = shares[i];
+            uint64_t hits = share.consumer->hits() - share.last_hits;
+            uint64_t misses = share.consumer->misses() - share.last_misses;
+            share.last_hits = share.consumer->hits();
+            share.last_misses = share.consumer->misses();
+            // Consumers that miss often and fill their limit benefit most from more memory.
+            double miss_ratio = (misses + 1.0) / (hits + misses + 2.0);
+            double fill = share.limit == 0 ? 1.0 : std::min(1.0, static_cast<double>(share.consumer->memory_usage()) / share.limit);
+            scores[i] = share.weight * (0.25 + miss_ratio) * (0.5 + fill);
+            total += scores[i];
+        }
+
+        for (size_t i = 0; i < shares.size(); i++) {
+            Share& share = shares[i];
+            size_t target = share.min + (total > 0 ? static_cast<size_t>(pool * scores[i] / total) : 0);
+            size_t limit = share.limit == 0 || (target < share.limit && rss > budget)
+                ? target
+                : static_cast<size_t>(share.limit * (1 - SMOOTHING) + target * SMOOTHING);
+            share.limit = limit;
+            share.consumer->set_memory_limit(limit);
+        }
+    }
+
+    void report() const {
+        for (const auto& r : reserved) {
+            std::cout << "  " << r.first << ": " << (r.second >> 20) << "MB reserved." << std::endl;
+        }
+        for (const auto& share : shares) {
+            std::cout << "  " << share.name << ": " << (share.consumer->memory_usage() >> 20) << "/" << (share.limit >> 20) << "MB." << std::endl;
+        }
+    }
+
+private:
+    struct Share {
+        std::string name;
+        MemoryConsumer* consumer;
+        size_t min;
+        double weight;
+        size_t limit = 0;
+        uint64_t last_hits = 0;
+        uint64_t last_misses = 0;
+    };
+
+    size_t budget = 0;
+    std::unordered_map<std::string, size_t> reserved;
+    std::vector<Share> shares;
+};
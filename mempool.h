@@ -0,0 +1,305 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <functional>
+#include <optional>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include "transaction_inscription.h"
+
+const std::chrono::seconds DEFAULT_MEMPOOL_POLL_INTERVAL(2);
+const std::chrono::hours DEFAULT_MEMPOOL_MAX_AGE(72);
+
+struct PendingTransfer {
+    std::string txid;
+    // Inscribed outpoint being spent ("txid:vout").
+    std::string outpoint;
+    uint32_t tx_in_index;
+};
+
+struct PendingTx {
+    std::string txid;
+    std::vector<TransactionInscription> inscriptions;
+    std::vector<PendingTransfer> transfers;
+    std::vector<std::string> spent;
+    std::vector<uint64_t> output_values;
+    // Outputs that receive a new or moved inscription.
+    std::vector<uint32_t> inscribed_vouts;
+    std::chrono::steady_clock::time_point first_seen;
+};
+
+// Follows the node's mempool over RPC and keeps an overlay of unconfirmed
+// inscriptions and transfers of inscribed outputs. The confirmed tables are
+// never written; entries leave the overlay when their tx confirms, is
+// replaced by a conflicting spend, drops out of the mempool or expires.
+//
+// Inscriptions follow ord's first-in first-out sat flow: a new inscription,
+// or one already on a spent outpoint, is taken to sit on the first sat of its
+// input, and lands on the output covering that sat offset (or in the fee).
+// Only spends of those outputs count as transfers of pending inscriptions.
+//
+// Rpc needs get_raw_mempool() -> std::vector<std::string> and
+// get_raw_transaction(txid) -> tx, so a mock that replays fixtures can stand
+// in for bitcoincore_rpc::Client (see mempool_test.cpp).
+template<typename Rpc>
+class MempoolFollower {
+public:
+    // is_inscribed and value_of look up confirmed outpoints and must be safe to
+    // call from the follower thread.
+    MempoolFollower(Rpc& rpc, std::function<bool(const std::string&)> is_inscribed, std::function<std::optional<uint64_t>(const std::string&)> value_of, std::chrono::seconds max_age = DEFAULT_MEMPOOL_MAX_AGE)
+        : rpc(rpc), is_inscribed(std::move(is_inscribed)), value_of(std::move(value_of)), max_age(max_age) {}
+
+    // Ingests transactions that entered the mempool since the last poll and
+    // drops the ones that left it.
+    void poll() {
+        std::vector<std::string> txids = rpc.get_raw_mempool();
+        std::unordered_set<std::string> current(txids.begin(), txids.end());
+
+        std::vector<std::string> fresh;
+        for (const auto& txid : txids) {
+            if (seen.insert(txid).second) {
+                fresh.push_back(txid);
+            }
+        }
+        for (auto it = seen.begin(); it != seen.end(); ) {
+            it = current.count(*it) ? std::next(it) : seen.erase(it);
+        }
+
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        for (auto it = pending.begin(); it != pending.end(); ) {
+            if (!current.count(it->first)) {
+                unindex_spends(it->second);
+                it = pending.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        lock.unlock();
+
+        for (const auto& txid : fresh) {
+            std::optional<decltype(rpc.get_raw_transaction(txid))> tx;
+            try {
+                tx.emplace(rpc.get_raw_transaction(txid));
+            } catch (...) {
+                // Evicted between listing and fetching.
+                continue;
+            }
+            ingest(*tx);
+        }
+        expire();
+    }
+
+    template<typename T>
+    void ingest(const T& tx) {
+        PendingTx entry;
+        entry.txid = tx.hash.to_string();
+        entry.first_seen = std::chrono::steady_clock::now();
+        entry.inscriptions = inscriptions_of(tx);
+        for (const auto& output : tx.value.outputs) {
+            entry.output_values.push_back(output.out.value);
+        }
+
+        std::vector<bool> carries_inscription(tx.value.inputs.size(), false);
+        for (const auto& inscription : entry.inscriptions) {
+            if (inscription.tx_in_index < carries_inscription.size()) {
+                carries_inscription[inscription.tx_in_index] = true;
+            }
+        }
+        std::vector<std::optional<uint64_t>> input_values;
+
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        for (uint32_t i = 0; i < tx.value.inputs.size(); i++) {
+            const auto& input = tx.value.inputs[i];
+            if (input.outpoint.is_null()) {
+                input_values.push_back(std::nullopt);
+                continue;
+            }
+            std::string txid = input.outpoint.txid.to_string();
+            uint32_t vout = input.outpoint.index;
+            std::string outpoint = txid + ":" + std::to_string(vout);
+            entry.spent.push_back(outpoint);
+            evict_conflict(outpoint, entry.txid);
+
+            auto parent = pending.find(txid);
+            bool inscribed;
+            if (parent != pending.end()) {
+                const PendingTx& p = parent->second;
+                inscribed = std::find(p.inscribed_vouts.begin(), p.inscribed_vouts.end(), vout) != p.inscribed_vouts.end();
+                input_values.push_back(vout < p.output_values.size() ? std::optional<uint64_t>(p.output_values[vout]) : std::nullopt);
+            } else {
+                inscribed = is_inscribed(outpoint);
+                input_values.push_back(value_of(outpoint));
+            }
+            if (inscribed) {
+                entry.transfers.push_back({entry.txid, outpoint, i});
+                carries_inscription[i] = true;
+            }
+        }
+        if (entry.inscriptions.empty() && entry.transfers.empty()) {
+            return;
+        }
+        entry.inscribed_vouts = inscribed_vouts(carries_inscription, input_values, entry.output_values);
+        for (const auto& outpoint : entry.spent) {
+            spenders[outpoint] = entry.txid;
+        }
+        pending[entry.txid] = std::move(entry);
+    }
+
+    // Drops everything the block confirms, and pending txs that conflict with
+    // the block's spends.
+    template<typename B>
+    void on_block(const B& block) {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        for (const auto& tx : block.txs) {
+            std::string txid = tx.hash.to_string();
+            auto found = pending.find(txid);
+            if (found != pending.end()) {
+                unindex_spends(found->second);
+                pending.erase(found);
+            }
+            for (const auto& input : tx.value.inputs) {
+                if (input.outpoint.is_null()) {
+                    continue;
+                }
+                evict_conflict(input.outpoint.txid.to_string() + ":" + std::to_string(input.outpoint.index), txid);
+            }
+        }
+    }
+
+    void expire() {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        for (auto it = pending.begin(); it != pending.end(); ) {
+            if (now - it->second.first_seen > max_age) {
+                unindex_spends(it->second);
+                it = pending.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    void run(const std::atomic<bool>& stop, std::chrono::seconds interval = DEFAULT_MEMPOOL_POLL_INTERVAL) {
+        while (!stop.load()) {
+            try {
+                poll();
+            } catch (const std::exception& e) {
+                std::cerr << "Mempool poll failed: " << e.what() << std::endl;
+            }
+            std::this_thread::sleep_for(interval);
+        }
+    }
+
+    std::vector<PendingTx> pending_inscriptions() const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        std::vector<PendingTx> result;
+        for (const auto& entry : pending) {
+            if (!entry.second.inscriptions.empty()) {
+                result.push_back(entry.second);
+            }
+        }
+        return result;
+    }
+
+    std::vector<PendingTransfer> pending_transfers() const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        std::vector<PendingTransfer> result;
+        for (const auto& entry : pending) {
+            result.insert(result.end(), entry.second.transfers.begin(), entry.second.transfers.end());
+        }
+        return result;
+    }
+
+    size_t size() const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        return pending.size();
+    }
+
+private:
+    Rpc& rpc;
+    std::function<bool(const std::string&)> is_inscribed;
+    std::function<std::optional<uint64_t>(const std::string&)> value_of;
+    std::chrono::seconds max_age;
+    std::unordered_set<std::string> seen;
+    std::unordered_map<std::string, PendingTx> pending;
+    // Spent outpoint -> pending txid, for replacement detection.
+    std::unordered_map<std::string, std::string> spenders;
+    mutable std::shared_mutex mutex;
+
+    // Maps the first sat of every inscription-carrying input to the output
+    // covering it. When an input value is unknown the offsets after it are
+    // too, and the inscription is assumed to land on output 0.
+    static std::vector<uint32_t> inscribed_vouts(const std::vector<bool>& carries_inscription, const std::vector<std::optional<uint64_t>>& input_values, const std::vector<uint64_t>& output_values) {
+        std::vector<uint32_t> vouts;
+        uint64_t offset = 0;
+        bool known = true;
+        for (size_t i = 0; i < carries_inscription.size(); i++) {
+            if (carries_inscription[i]) {
+                uint32_t vout = 0;
+                if (known) {
+                    uint64_t end = 0;
+                    for (vout = 0; vout < output_values.size(); vout++) {
+                        end += output_values[vout];
+                        if (offset < end) {
+                            break;
+                        }
+                    }
+                }
+                if (vout < output_values.size() && std::find(vouts.begin(), vouts.end(), vout) == vouts.end()) {
+                    vouts.push_back(vout);
+                }
+            }
+            if (input_values[i].has_value()) {
+                offset += *input_values[i];
+            } else {
+                known = false;
+            }
+        }
+        return vouts;
+    }
+
+    void unindex_spends(const PendingTx& entry) {
+        for (const auto& outpoint : entry.spent) {
+            auto found = spenders.find(outpoint);
+            if (found != spenders.end() && found->second == entry.txid) {
+                spenders.erase(found);
+            }
+        }
+    }
+
+    // Removes the pending tx that spends `outpoint` unless it is `txid`
+    // itself, along with any pending descendants that spend its outputs.
+    void evict_conflict(const std::string& outpoint, const std::string& txid) {
+        auto found = spenders.find(outpoint);
+        if (found == spenders.end() || found->second == txid) {
+            return;
+        }
+        std::vector<std::string> evict = {found->second};
+        while (!evict.empty()) {
+            std::string victim = evict.back();
+            evict.pop_back();
+            auto entry = pending.find(victim);
+            if (entry == pending.end()) {
+                continue;
+            }
+            unindex_spends(entry->second);
+            pending.erase(entry);
+            for (const auto& child : pending) {
+                for (const auto& spent : child.second.spent) {
+                    if (spent.compare(0, victim.size() + 1, victim + ":") == 0) {
+                        evict.push_back(child.first);
+                        break;
+                    }
+                }
+            }
+        }
+    }
+};
@@ -0,0 +1,207 @@
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <optional>
+#include <chrono>
+#include <thread>
+#include <stdexcept>
+#include <cstdint>
+#include "mempool.h"
+
+// Drives MempoolFollower through a mock RPC that replays mempool fixtures:
+// ingest, sat-flow of pending inscriptions, RBF eviction, confirmation,
+// mempool drop-out and expiry.
+
+namespace fixture {
+
+struct Hash {
+    std::string hex;
+    std::string to_string() const {
+        return hex;
+    }
+};
+
+struct Outpoint {
+    Hash txid;
+    uint32_t index;
+    bool is_null() const {
+        return txid.hex.empty();
+    }
+};
+
+struct Input {
+    Outpoint outpoint;
+};
+
+struct Out {
+    uint64_t value;
+};
+
+struct Output {
+    Out out;
+};
+
+struct Body {
+    std::vector<Input> inputs;
+    std::vector<Output> outputs;
+};
+
+struct Tx {
+    Hash hash;
+    Body value;
+    // Inputs whose witness carries an inscription envelope.
+    std::vector<uint32_t> envelope_inputs;
+};
+
+struct Block {
+    std::vector<Tx> txs;
+};
+
+std::vector<TransactionInscription> inscriptions_of(const Tx& tx) {
+    std::vector<TransactionInscription> result;
+    for (uint32_t input : tx.envelope_inputs) {
+        TransactionInscription inscription;
+        inscription.tx_in_index = input;
+        inscription.tx_in_offset = 0;
+        result.push_back(inscription);
+    }
+    return result;
+}
+
+Tx make_tx(const std::string& txid, const std::vector<std::string>& spends, const std::vector<uint64_t>& values, const std::vector<uint32_t>& envelope_inputs = {}) {
+    Tx tx;
+    tx.hash.hex = txid;
+    for (const std::string& spend : spends) {
+        size_t colon = spend.find(':');
+        tx.value.inputs.push_back({{{spend.substr(0, colon)}, static_cast<uint32_t>(std::stoul(spend.substr(colon + 1)))}});
+    }
+    for (uint64_t value : values) {
+        tx.value.outputs.push_back({{value}});
+    }
+    tx.envelope_inputs = envelope_inputs;
+    return tx;
+}
+
+}
+
+class MockRpc {
+public:
+    std::vector<std::string> mempool;
+    std::map<std::string, fixture::Tx> txs;
+
+    void replay(const std::vector<fixture::Tx>& snapshot) {
+        mempool.clear();
+        for (const fixture::Tx& tx : snapshot) {
+            mempool.push_back(tx.hash.hex);
+            txs[tx.hash.hex] = tx;
+        }
+    }
+
+    std::vector<std::string> get_raw_mempool() {
+        return mempool;
+    }
+
+    fixture::Tx get_raw_transaction(const std::string& txid) {
+        auto found = txs.find(txid);
+        if (found == txs.end()) {
+            throw std::runtime_error("No such mempool transaction: " + txid);
+        }
+        return found->second;
+    }
+};
+
+int failures = 0;
+
+void check(bool condition, const std::string& what) {
+    if (!condition) {
+        std::cerr << "FAIL: " << what << std::endl;
+        failures++;
+    }
+}
+
+std::set<std::string> inscription_txids(const MempoolFollower<MockRpc>& follower) {
+    std::set<std::string> txids;
+    for (const PendingTx& tx : follower.pending_inscriptions()) {
+        txids.insert(tx.txid);
+    }
+    return txids;
+}
+
+std::set<std::string> transfer_txids(const MempoolFollower<MockRpc>& follower) {
+    std::set<std::string> txids;
+    for (const PendingTransfer& transfer : follower.pending_transfers()) {
+        txids.insert(transfer.txid);
+    }
+    return txids;
+}
+
+int main() {
+    // Confirmed state: "insc:0" holds an inscription, every outpoint is worth 10000 sats.
+    std::set<std::string> inscribed = {"insc:0"};
+    auto is_inscribed = [&](const std::string& outpoint) { return inscribed.count(outpoint) > 0; };
+    auto value_of = [](const std::string&) -> std::optional<uint64_t> { return 10000; };
+
+    MockRpc rpc;
+    MempoolFollower<MockRpc> follower(rpc, is_inscribed, value_of);
+
+    // A reveal whose inscription lands on output 0 with change on output 1,
+    // a plain transfer of a confirmed inscription, and an unrelated payment.
+    fixture::Tx reveal = fixture::make_tx("reveal", {"fund:0"}, {546, 9000}, {0});
+    fixture::Tx transfer = fixture::make_tx("transfer", {"insc:0"}, {9500});
+    fixture::Tx payment = fixture::make_tx("payment", {"plain:0"}, {9000});
+    rpc.replay({reveal, transfer, payment});
+    follower.poll();
+    check(inscription_txids(follower) == std::set<std::string>{"reveal"}, "ingest keeps the reveal");
+    check(transfer_txids(follower) == std::set<std::string>{"transfer"}, "ingest flags the confirmed inscription transfer");
+    check(follower.size() == 2, "ingest drops transactions without inscriptions or transfers");
+
+    // Spending the reveal's change is not a transfer; spending output 0 is,
+    // and so is spending the output a pending transfer moved the inscription to.
+    fixture::Tx change_spend = fixture::make_tx("change_spend", {"reveal:1"}, {8000});
+    fixture::Tx reveal_spend = fixture::make_tx("reveal_spend", {"reveal:0"}, {546});
+    fixture::Tx transfer_spend = fixture::make_tx("transfer_spend", {"transfer:0"}, {9000});
+    rpc.replay({reveal, transfer, payment, change_spend, reveal_spend, transfer_spend});
+    follower.poll();
+    check(transfer_txids(follower) == std::set<std::string>{"transfer", "reveal_spend", "transfer_spend"}, "transfers follow the inscribed sat, not change outputs");
+
+    // RBF: a conflicting spend of "insc:0" replaces the transfer and its descendant.
+    fixture::Tx replacement = fixture::make_tx("replacement", {"insc:0"}, {9800});
+    rpc.replay({reveal, payment, change_spend, reveal_spend, replacement});
+    follower.poll();
+    check(transfer_txids(follower) == std::set<std::string>{"reveal_spend", "replacement"}, "replacement evicts the transfer and its descendants");
+
+    // Confirmation removes the reveal; its pending child stays.
+    fixture::Block block;
+    block.txs = {reveal};
+    follower.on_block(block);
+    inscribed.insert("reveal:0");
+    check(inscription_txids(follower).empty(), "confirmed reveal leaves the overlay");
+    check(transfer_txids(follower) == std::set<std::string>{"reveal_spend", "replacement"}, "children of a confirmed tx stay pending");
+
+    // A block spending the same outpoint as a pending tx evicts it.
+    fixture::Block conflicting;
+    conflicting.txs = {fixture::make_tx("mined", {"insc:0"}, {9900})};
+    follower.on_block(conflicting);
+    check(transfer_txids(follower) == std::set<std::string>{"reveal_spend"}, "block conflict evicts the pending spend");
+
+    // Drop-out: whatever leaves the mempool leaves the overlay.
+    rpc.replay({});
+    follower.poll();
+    check(follower.size() == 0, "mempool drop-out empties the overlay");
+
+    // Expiry: with a zero max age every entry is stale on the next sweep.
+    MockRpc expiring_rpc;
+    MempoolFollower<MockRpc> expiring(expiring_rpc, is_inscribed, value_of, std::chrono::seconds(0));
+    expiring.ingest(fixture::make_tx("old_reveal", {"fund:1"}, {546}, {0}));
+    check(expiring.size() == 1, "expiring follower ingests the reveal");
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    expiring.expire();
+    check(expiring.size() == 0, "expire drops entries older than the max age");
+
+    if (failures == 0) {
+        std::cout << "mempool follower fixtures passed." << std::endl;
+    }
+    return failures == 0 ? 0 : 1;
+}
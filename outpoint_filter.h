@@ -0,0 +1,258 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <unordered_map>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+
+const size_t OUTPOINT_FILTER_BUCKET_SIZE = 4;
+const size_t OUTPOINT_FILTER_MIN_BUCKETS = 1 << 16;
+const size_t OUTPOINT_FILTER_MAX_KICKS = 500;
+const size_t OUTPOINT_FILTER_MAX_STASH = 64;
+
+inline uint64_t outpoint_hash(const std::string& outpoint) {
+    // FNV-1a followed by a splitmix64 finalizer for well mixed high bits.
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (unsigned char c : outpoint) {
+        h ^= c;
+        h *= 0x100000001b3ull;
+    }
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ull;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebull;
+    h ^= h >> 31;
+    return h;
+}
+
+// Strips the trailing sat offset from a "txid:vout:offset" satpoint.
+inline std::string outpoint_of_satpoint(const std::string& satpoint) {
+    size_t first = satpoint.find(':');
+    if (first == std::string::npos) {
+        return satpoint;
+    }
+    size_t second = satpoint.find(':', first + 1);
+    return second == std::string::npos ? satpoint : satpoint.substr(0, second);
+}
+
+// Outpoints that gained or lost inscriptions in one block. Collected while
+// the block is applied and handed to the filter only once it has committed,
+// so a block that fails and is retried still sees the old state.
+struct OutpointFilterChanges {
+    std::vector<std::string> inserted;
+    std::vector<std::string> erased;
+};
+
+// Cuckoo filter over outpoints ("txid:vout") that currently hold at least one
+// inscription. A miss means the outpoint is definitely not inscribed and the
+// output_inscription lookup can be skipped; a hit still has to be confirmed
+// against the DB.
+//
+// Each (bucket pair, fingerprint) occupies one slot. Inserting a fingerprint
+// that is already present, whether for the same outpoint again or for a
+// colliding one, only bumps a collision count, and erase() drops that count
+// before it frees the slot. Repeated inserts therefore never fill buckets,
+// and an erase can never clear a fingerprint another outpoint still needs.
+//
+// erase() must only be called for outpoints that were inserted, otherwise it
+// can remove another outpoint's fingerprint and introduce false negatives.
+class OutpointFilter {
+public:
+    OutpointFilter() {
+        reset(0);
+    }
+
+    void reset(size_t expected) {
+        size_t buckets = OUTPOINT_FILTER_MIN_BUCKETS;
+        // Target ~50% load so inserts rarely have to kick.
+        while (buckets * OUTPOINT_FILTER_BUCKET_SIZE < expected * 2) {
+            buckets <<= 1;
+        }
+        table.assign(buckets * OUTPOINT_FILTER_BUCKET_SIZE, 0);
+        mask = buckets - 1;
+        count = 0;
+        stash.clear();
+        collisions.clear();
+        saturated = false;
+    }
+
+    void insert(const std::string& outpoint) {
+        uint64_t h = outpoint_hash(outpoint);
+        uint16_t fp = fingerprint(h);
+        size_t i1 = h & mask;
+        size_t i2 = alt_index(i1, fp);
+        if (has(i1, fp) || has(i2, fp) || in_stash(i1, i2, fp)) {
+            collisions[collision_key(i1, i2, fp)]++;
+            return;
+        }
+        count++;
+        if (put(i1, fp) || put(i2, fp)) {
+            return;
+        }
+        size_t i = (h >> 16) & 1 ? i1 : i2;
+        for (size_t kick = 0; kick < OUTPOINT_FILTER_MAX_KICKS; kick++) {
+            size_t slot = i * OUTPOINT_FILTER_BUCKET_SIZE + (kick % OUTPOINT_FILTER_BUCKET_SIZE);
+            std::swap(fp, table[slot]);
+            i = alt_index(i, fp);
+            if (put(i, fp)) {
+                return;
+            }
+        }
+        stash.push_back({i, fp});
+        if (stash.size() > OUTPOINT_FILTER_MAX_STASH) {
+            // Stay correct (every lookup hits) until the next rebuild resizes.
+            saturated = true;
+        }
+    }
+
+    void apply(const OutpointFilterChanges& changes) {
+        for (const auto& outpoint : changes.erased) {
+            erase(outpoint);
+        }
+        for (const auto& outpoint : changes.inserted) {
+            insert(outpoint);
+        }
+    }
+
+    bool may_contain(const std::string& outpoint) const {
+        if (saturated) {
+            return true;
+        }
+        uint64_t h = outpoint_hash(outpoint);
+        uint16_t fp = fingerprint(h);
+        size_t i1 = h & mask;
+        size_t i2 = alt_index(i1, fp);
+        return has(i1, fp) || has(i2, fp) || in_stash(i1, i2, fp);
+    }
+
+    void erase(const std::string& outpoint) {
+        uint64_t h = outpoint_hash(outpoint);
+        uint16_t fp = fingerprint(h);
+        size_t i1 = h & mask;
+        size_t i2 = alt_index(i1, fp);
+        auto shared = collisions.find(collision_key(i1, i2, fp));
+        if (shared != collisions.end()) {
+            if (--shared->second == 0) {
+                collisions.erase(shared);
+            }
+            return;
+        }
+        if (count > 0) {
+            count--;
+        }
+        if (remove(i1, fp) || remove(i2, fp)) {
+            return;
+        }
+        for (size_t k = 0; k < stash.size(); k++) {
+            if (stash[k].second == fp && (stash[k].first == i1 || stash[k].first == i2)) {
+                stash.erase(stash.begin() + k);
+                return;
+            }
+        }
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    bool is_saturated() const {
+        return saturated;
+    }
+
+    size_t memory_usage() const {
+        return table.size() * sizeof(uint16_t) + stash.size() * sizeof(stash[0])
+            + collisions.size() * (sizeof(uint64_t) + sizeof(uint32_t) + 2 * sizeof(void*));
+    }
+
+    // Repopulates the filter from inscription_output (inscription id -> satpoint).
+    // An outpoint holding several inscriptions is inserted once, so a single
+    // erase() on spend clears it.
+    template<typename D>
+    void rebuild(D& inscription_output) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        std::vector<std::string> outpoints;
+        auto iter = inscription_output.new_iter();
+        std::vector<uint8_t> key, value;
+        while (iter.advance()) {
+            iter.current(key, value);
+            outpoints.push_back(outpoint_of_satpoint(std::string(value.begin(), value.end())));
+        }
+        std::sort(outpoints.begin(), outpoints.end());
+        outpoints.erase(std::unique(outpoints.begin(), outpoints.end()), outpoints.end());
+        reset(outpoints.size());
+        for (const auto& outpoint : outpoints) {
+            insert(outpoint);
+        }
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+        std::cout << "Rebuilt inscribed outpoint filter with " << count << " entries, "
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << "ms." << std::endl;
+    }
+
+private:
+    std::vector<uint16_t> table;
+    std::vector<std::pair<size_t, uint16_t>> stash;
+    // Extra inserts per (bucket pair, fingerprint) beyond the one in a slot.
+    std::unordered_map<uint64_t, uint32_t> collisions;
+    size_t mask = 0;
+    size_t count = 0;
+    bool saturated = false;
+
+    static uint16_t fingerprint(uint64_t h) {
+        uint16_t fp = static_cast<uint16_t>(h >> 48);
+        return fp == 0 ? 1 : fp;
+    }
+
+    size_t alt_index(size_t i, uint16_t fp) const {
+        return (i ^ (static_cast<size_t>(fp) * 0x5bd1e995u)) & mask;
+    }
+
+    static uint64_t collision_key(size_t i1, size_t i2, uint16_t fp) {
+        return (static_cast<uint64_t>(std::min(i1, i2)) << 16) | fp;
+    }
+
+    bool in_stash(size_t i1, size_t i2, uint16_t fp) const {
+        for (const auto& victim : stash) {
+            if (victim.second == fp && (victim.first == i1 || victim.first == i2)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool put(size_t i, uint16_t fp) {
+        uint16_t* bucket = &table[i * OUTPOINT_FILTER_BUCKET_SIZE];
+        for (size_t k = 0; k < OUTPOINT_FILTER_BUCKET_SIZE; k++) {
+            if (bucket[k] == 0) {
+                bucket[k] = fp;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool has(size_t i, uint16_t fp) const {
+        const uint16_t* bucket = &table[i * OUTPOINT_FILTER_BUCKET_SIZE];
+        for (size_t k = 0; k < OUTPOINT_FILTER_BUCKET_SIZE; k++) {
+            if (bucket[k] == fp) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool remove(size_t i, uint16_t fp) {
+        uint16_t* bucket = &table[i * OUTPOINT_FILTER_BUCKET_SIZE];
+        for (size_t k = 0; k < OUTPOINT_FILTER_BUCKET_SIZE; k++) {
+            if (bucket[k] == fp) {
+                bucket[k] = 0;
+                return true;
+            }
+        }
+        return false;
+    }
+};
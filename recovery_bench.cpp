@@ -0,0 +1,324 @@
+#include <iostream>
+#include <filesystem>
+#include <fstream>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <csignal>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <bitcoin/system.hpp>
+#include "Ordi.h"
+
+namespace fs = std::filesystem;
+
+// Crash/restart recovery benchmark. Indexes a synthetic chain once to get the
+// reference state digest at the tip, then for every kill spec runs the
+// indexer with ordi_kill_at=<spec> until it SIGKILLs itself, restarts it on
+// the same data dir and reports how long the restart took to reach the tip
+// and whether the recovered digest matches the reference. A spec whose kill
+// point is never reached counts as a failure, since it tested nothing.
+//
+//   RecoveryBench <work dir> [block count] [kill spec...]
+//
+// Kill specs are <kill point>:<n>; see ORDI_KILL_POINT call sites. The
+// output_value.* points only fire below FIRST_INSCRIPTION_HEIGHT, so they
+// are not part of the defaults.
+//
+// SIGKILL only ends the process: data written with write(wb, false) or to
+// content segments without fsync is already in the page cache and survives
+// it. This measures recovery from process crashes, not from power loss or a
+// kernel panic, where unsynced writes are lost.
+
+typedef std::vector<uint8_t> Bytes;
+typedef std::array<uint8_t, 32> Hash;
+
+const int DEFAULT_BLOCK_COUNT = 200;
+const uint64_t SUBSIDY = 5000000000ull;
+
+void put_u32(Bytes& out, uint32_t n) {
+    for (int i = 0; i < 4; i++) {
+        out.push_back(static_cast<uint8_t>(n >> (8 * i)));
+    }
+}
+
+void put_u64(Bytes& out, uint64_t n) {
+    for (int i = 0; i < 8; i++) {
+        out.push_back(static_cast<uint8_t>(n >> (8 * i)));
+    }
+}
+
+void put_compact_size(Bytes& out, uint64_t n) {
+    if (n < 0xfd) {
+        out.push_back(static_cast<uint8_t>(n));
+    } else {
+        out.push_back(0xfd);
+        out.push_back(static_cast<uint8_t>(n));
+        out.push_back(static_cast<uint8_t>(n >> 8));
+    }
+}
+
+void put_bytes(Bytes& out, const Bytes& data) {
+    put_compact_size(out, data.size());
+    out.insert(out.end(), data.begin(), data.end());
+}
+
+Hash sha256d(const Bytes& data) {
+    libbitcoin::system::hash_digest digest = libbitcoin::system::sha256_hash(libbitcoin::system::sha256_hash(data));
+    Hash hash;
+    std::copy(digest.begin(), digest.end(), hash.begin());
+    return hash;
+}
+
+struct FixtureTx {
+    Bytes legacy;
+    Bytes full;
+    Hash txid;
+};
+
+// Single input, single-or-more output tx; witness, when given, makes it a
+// segwit serialization.
+FixtureTx make_tx(const Hash& prev_txid, uint32_t prev_vout, const Bytes& script_sig, const std::vector<uint64_t>& values, const std::vector<Bytes>& witness) {
+    Bytes inputs;
+    put_compact_size(inputs, 1);
+    inputs.insert(inputs.end(), prev_txid.begin(), prev_txid.end());
+    put_u32(inputs, prev_vout);
+    put_bytes(inputs, script_sig);
+    put_u32(inputs, 0xffffffff);
+
+    Bytes outputs;
+    put_compact_size(outputs, values.size());
+    for (uint64_t value : values) {
+        put_u64(outputs, value);
+        // OP_TRUE
+        put_bytes(outputs, Bytes{0x51});
+    }
+
+    FixtureTx tx;
+    put_u32(tx.legacy, 1);
+    tx.legacy.insert(tx.legacy.end(), inputs.begin(), inputs.end());
+    tx.legacy.insert(tx.legacy.end(), outputs.begin(), outputs.end());
+    put_u32(tx.legacy, 0);
+    tx.txid = sha256d(tx.legacy);
+
+    if (witness.empty()) {
+        tx.full = tx.legacy;
+        return tx;
+    }
+    put_u32(tx.full, 1);
+    tx.full.push_back(0x00);
+    tx.full.push_back(0x01);
+    tx.full.insert(tx.full.end(), inputs.begin(), inputs.end());
+    tx.full.insert(tx.full.end(), outputs.begin(), outputs.end());
+    put_compact_size(tx.full, witness.size());
+    for (const Bytes& item : witness) {
+        put_bytes(tx.full, item);
+    }
+    put_u32(tx.full, 0);
+    return tx;
+}
+
+// Tapscript spend carrying a text/plain inscription envelope.
+std::vector<Bytes> inscription_witness(const std::string& body) {
+    Bytes script = {0x00, 0x63, 0x03, 'o', 'r', 'd', 0x01, 0x01, 0x0a};
+    std::string content_type = "text/plain";
+    script.insert(script.end(), content_type.begin(), content_type.end());
+    script.push_back(0x00);
+    script.push_back(static_cast<uint8_t>(body.size()));
+    script.insert(script.end(), body.begin(), body.end());
+    script.push_back(0x68);
+    Bytes control(33, 0);
+    control[0] = 0xc0;
+    return {Bytes(64, 0), script, control};
+}
+
+Hash merkle_root(std::vector<Hash> level) {
+    while (level.size() > 1) {
+        if (level.size() % 2 == 1) {
+            level.push_back(level.back());
+        }
+        std::vector<Hash> next;
+        for (size_t i = 0; i < level.size(); i += 2) {
+            Bytes pair(level[i].begin(), level[i].end());
+            pair.insert(pair.end(), level[i + 1].begin(), level[i + 1].end());
+            next.push_back(sha256d(pair));
+        }
+        level.swap(next);
+    }
+    return level.front();
+}
+
+// Writes <btc_data_dir>/blocks/blk00000.dat: a genesis block followed by
+// `block_count` blocks, each with a coinbase and a tx that spends the
+// previous coinbase through an inscription reveal.
+void write_fixture(const fs::path& btc_data_dir, int block_count) {
+    fs::create_directories(btc_data_dir / BLOCKS_PATH);
+    std::ofstream file(btc_data_dir / BLOCKS_PATH / blk_file_name(0), std::ios::binary | std::ios::trunc);
+    Hash prev_block{};
+    Hash prev_coinbase{};
+    for (int height = 0; height <= block_count; height++) {
+        Bytes coinbase_script = {0x03, static_cast<uint8_t>(height), static_cast<uint8_t>(height >> 8), static_cast<uint8_t>(height >> 16)};
+        std::vector<FixtureTx> txs;
+        txs.push_back(make_tx(Hash{}, 0xffffffff, coinbase_script, {SUBSIDY}, {}));
+        if (height > 0) {
+            std::string body = "recovery fixture " + std::to_string(height);
+            txs.push_back(make_tx(prev_coinbase, 0, Bytes(), {10000, SUBSIDY - 20000}, inscription_witness(body)));
+        }
+        prev_coinbase = txs.front().txid;
+
+        std::vector<Hash> txids;
+        for (const FixtureTx& tx : txs) {
+            txids.push_back(tx.txid);
+        }
+        Bytes block;
+        put_u32(block, 1);
+        block.insert(block.end(), prev_block.begin(), prev_block.end());
+        Hash root = merkle_root(txids);
+        block.insert(block.end(), root.begin(), root.end());
+        put_u32(block, 1231006505 + height * 600);
+        put_u32(block, 0x207fffff);
+        put_u32(block, height);
+        prev_block = sha256d(Bytes(block.begin(), block.end()));
+        put_compact_size(block, txs.size());
+        for (const FixtureTx& tx : txs) {
+            block.insert(block.end(), tx.full.begin(), tx.full.end());
+        }
+
+        Bytes record;
+        put_u32(record, Bitcoin::MAGIC);
+        put_u32(record, static_cast<uint32_t>(block.size()));
+        file.write(reinterpret_cast<const char*>(record.data()), record.size());
+        file.write(reinterpret_cast<const char*>(block.data()), block.size());
+    }
+    if (!file) {
+        throw std::runtime_error("Failed to write fixture to " + btc_data_dir.string());
+    }
+}
+
+struct RunResult {
+    bool killed = false;
+    int exit_code = 0;
+    std::string digest;
+    double seconds = 0;
+};
+
+// Indexes in a forked child so a kill point takes down only the child. The
+// child reports the digest at its committed tip through a pipe.
+RunResult run_indexer(const fs::path& btc_data_dir, const fs::path& ordi_data_dir, const std::string& kill_spec) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        throw std::runtime_error("pipe failed");
+    }
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    pid_t pid = fork();
+    if (pid < 0) {
+        throw std::runtime_error("fork failed");
+    }
+    if (pid == 0) {
+        ::close(fds[0]);
+        setenv("btc_data_dir", btc_data_dir.c_str(), 1);
+        setenv("ordi_data_dir", ordi_data_dir.c_str(), 1);
+        setenv("btc_index_source", "blk", 1);
+        setenv("ordi_exit_at_tip", "1", 1);
+        if (kill_spec.empty()) {
+            unsetenv("ordi_kill_at");
+        } else {
+            setenv("ordi_kill_at", kill_spec.c_str(), 1);
+        }
+        int code = 0;
+        try {
+            Ordi ordi{Options()};
+            ordi.index_output_value();
+            ordi.start();
+            std::string line = std::to_string(ordi.committed_height()) + " " + ordi.state_digest_at(ordi.committed_height()) + "\n";
+            if (write(fds[1], line.data(), line.size()) != static_cast<ssize_t>(line.size())) {
+                code = 2;
+            }
+            ordi.close();
+        } catch (const std::exception& e) {
+            std::cerr << "indexer: " << e.what() << std::endl;
+            code = 1;
+        }
+        _exit(code);
+    }
+
+    ::close(fds[1]);
+    std::string output;
+    char buffer[256];
+    ssize_t n;
+    while ((n = read(fds[0], buffer, sizeof(buffer))) > 0) {
+        output.append(buffer, n);
+    }
+    ::close(fds[0]);
+    int status = 0;
+    waitpid(pid, &status, 0);
+
+    RunResult result;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.killed = WIFSIGNALED(status) && WTERMSIG(status) == SIGKILL;
+    result.exit_code = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+    while (!output.empty() && output.back() == '\n') {
+        output.pop_back();
+    }
+    result.digest = output;
+    return result;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " <work dir> [block count] [kill point:n ...]" << std::endl;
+        return 2;
+    }
+    fs::path work_dir(argv[1]);
+    int block_count = argc > 2 ? std::stoi(argv[2]) : DEFAULT_BLOCK_COUNT;
+    std::vector<std::string> kill_specs;
+    for (int i = 3; i < argc; i++) {
+        kill_specs.push_back(argv[i]);
+    }
+    if (kill_specs.empty()) {
+        // Every fixture block above genesis carries an inscription, so each
+        // of these is reached once per block.
+        std::string middle = std::to_string(std::max(block_count / 2, 1));
+        kill_specs = {
+            "block.after_commit:1",
+            "block.after_commit:" + middle,
+            "content_store.before_sync:1",
+            "content_store.before_sync:" + middle,
+            "block.before_status:" + middle,
+        };
+    }
+
+    fs::remove_all(work_dir);
+    fs::path btc_data_dir = work_dir / "btc";
+    write_fixture(btc_data_dir, block_count);
+
+    RunResult reference = run_indexer(btc_data_dir, work_dir / "reference", "");
+    if (reference.killed || reference.exit_code != 0 || reference.digest.empty()) {
+        std::cerr << "Reference run failed with exit code " << reference.exit_code << "." << std::endl;
+        return 1;
+    }
+    std::cout << "Reference: " << block_count + 1 << " blocks in " << reference.seconds << "s, tip " << reference.digest << std::endl;
+
+    int failures = 0;
+    for (size_t i = 0; i < kill_specs.size(); i++) {
+        fs::path ordi_data_dir = work_dir / ("trial-" + std::to_string(i));
+        RunResult crashed = run_indexer(btc_data_dir, ordi_data_dir, kill_specs[i]);
+        if (!crashed.killed) {
+            std::cout << kill_specs[i] << ": NOT REACHED (exit code " << crashed.exit_code << ")" << std::endl;
+            failures++;
+            continue;
+        }
+        RunResult recovered = run_indexer(btc_data_dir, ordi_data_dir, "");
+        bool ok = !recovered.killed && recovered.exit_code == 0 && recovered.digest == reference.digest;
+        failures += ok ? 0 : 1;
+        std::cout << kill_specs[i]
+            << ": killed after " << crashed.seconds << "s"
+            << ", recovered to tip in " << recovered.seconds << "s"
+            << ", digest " << (ok ? "match" : "MISMATCH (" + recovered.digest + ")") << std::endl;
+    }
+    return failures == 0 ? 0 : 1;
+}
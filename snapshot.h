@@ -0,0 +1,326 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zstd.h>
+#include "varint.h"
+
+const char SNAPSHOT_MAGIC[8] = {'O', 'R', 'D', 'I', 'S', 'N', 'P', '1'};
+const uint32_t SNAPSHOT_FORMAT_VERSION = 1;
+const size_t SNAPSHOT_CHUNK_SIZE = 4 << 20;
+const int SNAPSHOT_COMPRESSION_LEVEL = 3;
+
+class SnapshotError : public std::exception {
+public:
+    SnapshotError(const std::string& message) : message(message) {}
+    const char* what() const noexcept override {
+        return message.c_str();
+    }
+private:
+    std::string message;
+};
+
+inline uint32_t crc32c(const uint8_t* data, size_t len) {
+    static const std::array<uint32_t, 256> table = [] {
+        std::array<uint32_t, 256> t;
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) {
+                c = c & 1 ? 0x82f63b78 ^ (c >> 1) : c >> 1;
+            }
+            t[i] = c;
+        }
+        return t;
+    }();
+    uint32_t crc = 0xffffffff;
+    for (size_t i = 0; i < len; i++) {
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return crc ^ 0xffffffff;
+}
+
+// A chunk holds a key-ordered run of one table: zstd([varint klen][k][varint vlen][v]...).
+struct SnapshotChunk {
+    uint32_t table;
+    uint32_t sequence;
+    uint32_t record_count;
+    uint32_t crc;
+    uint64_t offset;
+    uint64_t compressed_len;
+    uint64_t raw_len;
+};
+
+// Layout:
+//   magic, format version, height, table count, table names
+//   chunks, written in parallel at reserved offsets
+//   chunk directory, directory crc, directory offset, magic
+//
+// Every table is dumped by its own thread; the caller must guarantee that no
+// block is being indexed so that all tables reflect the same committed height.
+template<typename D>
+void export_snapshot(const std::string& path, uint64_t height, const std::vector<std::pair<std::string, D*>>& tables) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw SnapshotError("Failed to create snapshot: " + path);
+    }
+
+    std::string header(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    put_varint(header, SNAPSHOT_FORMAT_VERSION);
+    put_varint(header, height);
+    put_varint(header, tables.size());
+    for (const auto& table : tables) {
+        put_varint(header, table.first.size());
+        header += table.first;
+    }
+    if (pwrite(fd, header.data(), header.size(), 0) != static_cast<ssize_t>(header.size())) {
+        ::close(fd);
+        throw SnapshotError("Failed to write snapshot header: " + path);
+    }
+
+    std::atomic<uint64_t> next_offset(header.size());
+    std::mutex directory_mutex;
+    std::vector<SnapshotChunk> directory;
+    std::vector<std::string> errors(tables.size());
+    std::vector<std::thread> workers;
+
+    for (uint32_t t = 0; t < tables.size(); t++) {
+        workers.emplace_back([&, t]() {
+            try {
+                ZSTD_CCtx* cctx = ZSTD_createCCtx();
+                uint32_t sequence = 0;
+                uint32_t record_count = 0;
+                std::string raw;
+                std::vector<uint8_t> compressed;
+
+                auto flush = [&]() {
+                    compressed.resize(ZSTD_compressBound(raw.size()));
+                    size_t n = ZSTD_compressCCtx(cctx, compressed.data(), compressed.size(), raw.data(), raw.size(), SNAPSHOT_COMPRESSION_LEVEL);
+                    if (ZSTD_isError(n)) {
+                        throw SnapshotError(std::string("Failed to compress snapshot chunk: ") + ZSTD_getErrorName(n));
+                    }
+                    SnapshotChunk chunk;
+                    chunk.table = t;
+                    chunk.sequence = sequence++;
+                    chunk.record_count = record_count;
+                    chunk.crc = crc32c(compressed.data(), n);
+                    chunk.offset = next_offset.fetch_add(n);
+                    chunk.compressed_len = n;
+                    chunk.raw_len = raw.size();
+                    if (pwrite(fd, compressed.data(), n, chunk.offset) != static_cast<ssize_t>(n)) {
+                        throw SnapshotError("Failed to write snapshot chunk of " + tables[t].first);
+                    }
+                    {
+                        std::lock_guard<std::mutex> lock(directory_mutex);
+                        directory.push_back(chunk);
+                    }
+                    raw.clear();
+                    record_count = 0;
+                };
+
+                auto iter = tables[t].second->new_iter();
+                std::vector<uint8_t> key, value;
+                while (iter.advance()) {
+                    iter.current(key, value);
+                    put_varint(raw, key.size());
+                    raw.append(key.begin(), key.end());
+                    put_varint(raw, value.size());
+                    raw.append(value.begin(), value.end());
+                    record_count++;
+                    if (raw.size() >= SNAPSHOT_CHUNK_SIZE) {
+                        flush();
+                    }
+                }
+                if (record_count > 0) {
+                    flush();
+                }
+                ZSTD_freeCCtx(cctx);
+            } catch (const std::exception& e) {
+                errors[t] = e.what();
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    for (const auto& error : errors) {
+        if (!error.empty()) {
+            ::close(fd);
+            throw SnapshotError(error);
+        }
+    }
+
+    std::sort(directory.begin(), directory.end(), [](const SnapshotChunk& a, const SnapshotChunk& b) {
+        return a.table != b.table ? a.table < b.table : a.sequence < b.sequence;
+    });
+    std::string trailer;
+    put_varint(trailer, directory.size());
+    for (const auto& chunk : directory) {
+        put_varint(trailer, chunk.table);
+        put_varint(trailer, chunk.sequence);
+        put_varint(trailer, chunk.record_count);
+        put_varint(trailer, chunk.crc);
+        put_varint(trailer, chunk.offset);
+        put_varint(trailer, chunk.compressed_len);
+        put_varint(trailer, chunk.raw_len);
+    }
+    uint32_t directory_crc = crc32c(reinterpret_cast<const uint8_t*>(trailer.data()), trailer.size());
+    uint64_t directory_offset = next_offset.load();
+    trailer.append(reinterpret_cast<const char*>(&directory_crc), 4);
+    trailer.append(reinterpret_cast<const char*>(&directory_offset), 8);
+    trailer.append(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    if (pwrite(fd, trailer.data(), trailer.size(), directory_offset) != static_cast<ssize_t>(trailer.size())) {
+        ::close(fd);
+        throw SnapshotError("Failed to write snapshot directory: " + path);
+    }
+    fsync(fd);
+    ::close(fd);
+
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    std::cout << "Exported snapshot at height " << height << " with " << directory.size() << " chunks, "
+              << std::chrono::duration_cast<std::chrono::seconds>(end - start).count() << "s." << std::endl;
+}
+
+// Verifies every chunk and loads each table on its own thread, in key order,
+// one WriteBatch per chunk. Tables must be empty. Returns the snapshot height.
+template<typename D>
+uint64_t import_snapshot(const std::string& path, const std::vector<std::pair<std::string, D*>>& tables) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw SnapshotError("Failed to open snapshot: " + path);
+    }
+    struct stat st;
+    fstat(fd, &st);
+    size_t size = static_cast<size_t>(st.st_size);
+    void* addr = size > 0 ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        throw SnapshotError("Failed to mmap snapshot: " + path);
+    }
+    const char* data = static_cast<const char*>(addr);
+    std::unique_ptr<void, std::function<void(void*)>> unmap(addr, [size](void* p) { munmap(p, size); });
+    if (size < 2 * sizeof(SNAPSHOT_MAGIC) + 12 || std::memcmp(data, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0
+        || std::memcmp(data + size - sizeof(SNAPSHOT_MAGIC), SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0) {
+        throw SnapshotError("Not a snapshot or truncated: " + path);
+    }
+
+    size_t pos = sizeof(SNAPSHOT_MAGIC);
+    if (get_varint(data, size, pos) != SNAPSHOT_FORMAT_VERSION) {
+        throw SnapshotError("Unsupported snapshot format: " + path);
+    }
+    uint64_t height = get_varint(data, size, pos);
+    uint64_t table_count = get_varint(data, size, pos);
+    std::vector<D*> targets(table_count, nullptr);
+    for (uint64_t t = 0; t < table_count; t++) {
+        uint64_t len = get_varint(data, size, pos);
+        if (pos + len > size) {
+            throw SnapshotError("Truncated snapshot header: " + path);
+        }
+        std::string name(data + pos, len);
+        pos += len;
+        for (const auto& table : tables) {
+            if (table.first == name) {
+                targets[t] = table.second;
+            }
+        }
+        if (targets[t] == nullptr) {
+            throw SnapshotError("Snapshot table has no target: " + name);
+        }
+    }
+
+    uint32_t directory_crc;
+    uint64_t directory_offset;
+    size_t trailer_end = size - sizeof(SNAPSHOT_MAGIC);
+    std::memcpy(&directory_offset, data + trailer_end - 8, 8);
+    std::memcpy(&directory_crc, data + trailer_end - 12, 4);
+    size_t directory_end = trailer_end - 12;
+    if (directory_offset > directory_end
+        || crc32c(reinterpret_cast<const uint8_t*>(data) + directory_offset, directory_end - directory_offset) != directory_crc) {
+        throw SnapshotError("Corrupted snapshot directory: " + path);
+    }
+    pos = directory_offset;
+    std::vector<std::vector<SnapshotChunk>> chunks(table_count);
+    uint64_t chunk_count = get_varint(data, directory_end, pos);
+    for (uint64_t i = 0; i < chunk_count; i++) {
+        SnapshotChunk chunk;
+        chunk.table = static_cast<uint32_t>(get_varint(data, directory_end, pos));
+        chunk.sequence = static_cast<uint32_t>(get_varint(data, directory_end, pos));
+        chunk.record_count = static_cast<uint32_t>(get_varint(data, directory_end, pos));
+        chunk.crc = static_cast<uint32_t>(get_varint(data, directory_end, pos));
+        chunk.offset = get_varint(data, directory_end, pos);
+        chunk.compressed_len = get_varint(data, directory_end, pos);
+        chunk.raw_len = get_varint(data, directory_end, pos);
+        if (chunk.table >= table_count || chunk.offset + chunk.compressed_len > directory_offset) {
+            throw SnapshotError("Invalid snapshot chunk " + std::to_string(i));
+        }
+        chunks[chunk.table].push_back(chunk);
+    }
+
+    std::vector<std::string> errors(table_count);
+    std::vector<std::thread> workers;
+    for (uint32_t t = 0; t < table_count; t++) {
+        workers.emplace_back([&, t]() {
+            try {
+                ZSTD_DCtx* dctx = ZSTD_createDCtx();
+                std::string raw;
+                for (const auto& chunk : chunks[t]) {
+                    const uint8_t* payload = reinterpret_cast<const uint8_t*>(data) + chunk.offset;
+                    if (crc32c(payload, chunk.compressed_len) != chunk.crc) {
+                        throw SnapshotError("Checksum mismatch in snapshot chunk " + std::to_string(chunk.sequence) + " of table " + std::to_string(t));
+                    }
+                    raw.resize(chunk.raw_len);
+                    size_t n = ZSTD_decompressDCtx(dctx, &raw[0], raw.size(), payload, chunk.compressed_len);
+                    if (ZSTD_isError(n) || n != chunk.raw_len) {
+                        throw SnapshotError("Failed to decompress snapshot chunk " + std::to_string(chunk.sequence) + " of table " + std::to_string(t));
+                    }
+                    WriteBatch wb;
+                    size_t p = 0;
+                    for (uint32_t r = 0; r < chunk.record_count; r++) {
+                        uint64_t klen = get_varint(raw, p);
+                        std::string k = raw.substr(p, klen);
+                        p += klen;
+                        uint64_t vlen = get_varint(raw, p);
+                        std::string v = raw.substr(p, vlen);
+                        p += vlen;
+                        wb.put(k, v);
+                    }
+                    targets[t]->write(wb, false);
+                }
+                targets[t]->flush();
+                ZSTD_freeDCtx(dctx);
+            } catch (const std::exception& e) {
+                errors[t] = e.what();
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    for (const auto& error : errors) {
+        if (!error.empty()) {
+            throw SnapshotError(error);
+        }
+    }
+
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    std::cout << "Imported snapshot at height " << height << " with " << chunk_count << " chunks, "
+              << std::chrono::duration_cast<std::chrono::seconds>(end - start).count() << "s." << std::endl;
+    return height;
+}
@@ -0,0 +1,204 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory_resource>
+#include <optional>
+#include <algorithm>
+#include <unordered_map>
+#include <cstdint>
+#include <cstring>
+#include "outpoint_filter.h"
+#include "memory_governor.h"
+#include "arena.h"
+
+// RPC transactions nest inputs and outputs under `value`. Decoded blocks
+// (RawTx, bitcoin/block_reader.h) provide non-template overloads, so resolve()
+// works on either. Both share hash.to_string() and the outpoint's
+// txid.to_string(), index and is_null().
+template<typename T>
+const auto& tx_inputs(const T& tx) {
+    return tx.value.inputs;
+}
+
+template<typename T>
+size_t tx_output_count(const T& tx) {
+    return tx.value.outputs.size();
+}
+
+template<typename T>
+uint64_t tx_output_value(const T& tx, size_t vout) {
+    return tx.value.outputs[vout].out.value;
+}
+
+struct ResolvedInput {
+    ResolvedInput(std::pmr::memory_resource* resource) : outpoint(resource) {}
+
+    std::pmr::string outpoint;
+    uint64_t value = 0;
+    // False for coinbase inputs and outpoints missing from output_value.
+    bool found = false;
+    // Created by an earlier tx of the same block; its inscriptions, if any,
+    // are only known to the BlockUpdater's in-memory state.
+    bool in_block = false;
+    // Raw output_inscription value for the outpoint, if it holds inscriptions.
+    std::optional<std::string> inscriptions;
+};
+
+// Resolves every spent outpoint of a block in one pass before the block is
+// applied. Outpoints created earlier in the same block are answered from
+// memory; the rest are deduplicated, sorted by key and looked up with a
+// single forward-moving iterator per table, so LevelDB reads walk the key
+// space in order instead of hopping around it in tx order.
+//
+// Afterwards input_offset() gives the sat offset at which each input's sats
+// start within its transaction, as needed for inscription sat tracking.
+//
+// The created-output map and the outpoint strings live in the block arena;
+// call clear() before the arena is reset.
+class SpentResolver {
+public:
+    template<typename B, typename D>
+    void resolve(const B& block, D& output_value, D& output_inscription, BoundedCache<std::string, uint64_t>& value_cache, const OutpointFilter& inscribed_outpoints, BlockArena& arena) {
+        clear();
+        std::pmr::memory_resource* resource = arena.get();
+
+        std::pmr::unordered_map<std::pmr::string, uint64_t> created(resource);
+        for (const auto& tx : block.txs) {
+            std::string txid = tx.hash.to_string();
+            for (size_t vout = 0; vout < tx_output_count(tx); vout++) {
+                created.emplace(outpoint_key(txid, vout, resource), tx_output_value(tx, vout));
+            }
+        }
+
+        std::vector<size_t> pending;
+        for (const auto& tx : block.txs) {
+            tx_input_start.push_back(inputs.size());
+            for (const auto& input : tx_inputs(tx)) {
+                ResolvedInput resolved(resource);
+                if (!input.outpoint.is_null()) {
+                    resolved.outpoint = outpoint_key(input.outpoint.txid.to_string(), input.outpoint.index, resource);
+                    auto found = created.find(resolved.outpoint);
+                    if (found != created.end()) {
+                        resolved.value = found->second;
+                        resolved.found = true;
+                        resolved.in_block = true;
+                        created.erase(found);
+                    } else if (value_cache.get(std::string(resolved.outpoint), resolved.value)) {
+                        resolved.found = true;
+                        value_cache.erase(std::string(resolved.outpoint));
+                        pending.push_back(inputs.size());
+                    } else {
+                        pending.push_back(inputs.size());
+                    }
+                }
+                inputs.push_back(std::move(resolved));
+            }
+        }
+        tx_input_start.push_back(inputs.size());
+
+        std::sort(pending.begin(), pending.end(), [this](size_t a, size_t b) {
+            return inputs[a].outpoint < inputs[b].outpoint;
+        });
+
+        lookup_values(output_value, pending);
+        lookup_inscriptions(output_inscription, pending, inscribed_outpoints);
+
+        prefix.resize(inputs.size() + tx_input_start.size() - 1);
+        for (size_t tx = 0; tx + 1 < tx_input_start.size(); tx++) {
+            uint64_t offset = 0;
+            for (size_t i = tx_input_start[tx]; i < tx_input_start[tx + 1]; i++) {
+                prefix[i + tx] = offset;
+                offset += inputs[i].value;
+            }
+            prefix[tx_input_start[tx + 1] + tx] = offset;
+        }
+
+        // Outputs that survive the block are likely to be spent soon.
+        for (const auto& output : created) {
+            value_cache.put(std::string(output.first), output.second);
+        }
+    }
+
+    // Drops every reference into the block arena.
+    void clear() {
+        inputs.clear();
+        tx_input_start.clear();
+        prefix.clear();
+    }
+
+    const ResolvedInput& input(size_t tx_index, size_t input_index) const {
+        return inputs[tx_input_start[tx_index] + input_index];
+    }
+
+    // Sat offset of the first sat of `input_index` within the tx's inputs.
+    uint64_t input_offset(size_t tx_index, size_t input_index) const {
+        return prefix[tx_input_start[tx_index] + input_index + tx_index];
+    }
+
+    uint64_t input_total(size_t tx_index) const {
+        return prefix[tx_input_start[tx_index + 1] + tx_index];
+    }
+
+private:
+    std::vector<ResolvedInput> inputs;
+    std::vector<size_t> tx_input_start;
+    // Per tx, input count + 1 running sums laid out back to back.
+    std::vector<uint64_t> prefix;
+    // Reused seek key, so lookups do not allocate per outpoint.
+    std::string seek_key;
+
+    static std::pmr::string outpoint_key(const std::string& txid, size_t vout, std::pmr::memory_resource* resource) {
+        std::pmr::string key(resource);
+        std::string index = std::to_string(vout);
+        key.reserve(txid.size() + 1 + index.size());
+        key.append(txid).append(1, ':').append(index);
+        return key;
+    }
+
+    template<typename D>
+    void lookup_values(D& output_value, const std::vector<size_t>& sorted) {
+        auto iter = output_value.new_iter();
+        std::vector<uint8_t> key, value;
+        const ResolvedInput* previous = nullptr;
+        for (size_t index : sorted) {
+            ResolvedInput& resolved = inputs[index];
+            if (resolved.found) {
+                continue;
+            }
+            if (previous != nullptr && previous->outpoint == resolved.outpoint) {
+                // Same outpoint spent twice in one block; the block is invalid
+                // but both inputs should at least agree.
+                resolved.value = previous->value;
+                resolved.found = previous->found;
+                continue;
+            }
+            previous = &resolved;
+            seek_key.assign(resolved.outpoint.begin(), resolved.outpoint.end());
+            iter.seek(seek_key);
+            if (iter.current(key, value) && key.size() == resolved.outpoint.size()
+                && std::equal(key.begin(), key.end(), resolved.outpoint.begin()) && value.size() == sizeof(uint64_t)) {
+                std::memcpy(&resolved.value, value.data(), sizeof(uint64_t));
+                resolved.found = true;
+            }
+        }
+    }
+
+    template<typename D>
+    void lookup_inscriptions(D& output_inscription, const std::vector<size_t>& sorted, const OutpointFilter& inscribed_outpoints) {
+        auto iter = output_inscription.new_iter();
+        std::vector<uint8_t> key, value;
+        for (size_t index : sorted) {
+            ResolvedInput& resolved = inputs[index];
+            seek_key.assign(resolved.outpoint.begin(), resolved.outpoint.end());
+            if (!inscribed_outpoints.may_contain(seek_key)) {
+                continue;
+            }
+            iter.seek(seek_key);
+            if (iter.current(key, value) && key.size() == resolved.outpoint.size()
+                && std::equal(key.begin(), key.end(), resolved.outpoint.begin())) {
+                resolved.inscriptions = std::string(value.begin(), value.end());
+            }
+        }
+    }
+};
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <string>
+#include <array>
+#include <vector>
+#include <optional>
+#include <cstdint>
+#include <cstring>
+#include <bitcoin/system.hpp>
+#include "varint.h"
+
+// Key prefix in `status` for the cumulative digest at a height (8 byte BE).
+const std::string STATUS_DIGEST_PREFIX = "digest:";
+
+enum class DigestOp : uint8_t {
+    Put = 1,
+    Delete = 2,
+    InscriptionMove = 3,
+    BalanceDelta = 4,
+};
+
+// Incremental multiset hash over every change the indexer commits: each
+// change is hashed with sha256 and added (or, for a put that is later
+// reverted, subtracted) modulo 2^256. Addition commutes, so the digest does
+// not depend on the order changes are applied within or across code paths,
+// only on the set of changes up to a height. Two replicas agree at height h
+// iff their digests at h are equal, which makes divergence bisectable.
+class StateDigest {
+public:
+    StateDigest() {
+        acc.fill(0);
+    }
+
+    void put(const std::string& table, const std::string& key, const std::string& value) {
+        fold(DigestOp::Put, table, key, value, true);
+    }
+
+    void del(const std::string& table, const std::string& key) {
+        fold(DigestOp::Delete, table, key, std::string(), true);
+    }
+
+    void inscription_move(const std::string& inscription_id, const std::string& from, const std::string& to) {
+        fold(DigestOp::InscriptionMove, inscription_id, from, to, true);
+    }
+
+    void balance_delta(uint32_t address_id, uint32_t ticker_id, int64_t delta) {
+        std::string key(8, '\0');
+        std::memcpy(&key[0], &address_id, 4);
+        std::memcpy(&key[4], &ticker_id, 4);
+        std::string value(reinterpret_cast<const char*>(&delta), 8);
+        fold(DigestOp::BalanceDelta, "brc20", key, value, true);
+    }
+
+    // Undoes a previous put/del/move with identical arguments.
+    void revert(DigestOp op, const std::string& table, const std::string& key, const std::string& value) {
+        fold(op, table, key, value, false);
+    }
+
+    std::string encode() const {
+        std::string out(32, '\0');
+        std::memcpy(&out[0], acc.data(), 32);
+        return out;
+    }
+
+    std::string to_hex() const {
+        static const char* digits = "0123456789abcdef";
+        std::string bytes = encode();
+        std::string hex;
+        // Most significant limb first so the hex reads like a big number.
+        for (size_t i = bytes.size(); i-- > 0; ) {
+            uint8_t b = static_cast<uint8_t>(bytes[i]);
+            hex.push_back(digits[b >> 4]);
+            hex.push_back(digits[b & 0xf]);
+        }
+        return hex;
+    }
+
+    static std::string key_at(uint64_t height) {
+        std::string key = STATUS_DIGEST_PREFIX;
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            key.push_back(static_cast<char>(height >> shift));
+        }
+        return key;
+    }
+
+    // Adds the digest at `height` to the block's status batch so it commits
+    // atomically with the height itself.
+    template<typename W>
+    void stage(W& wb, uint64_t height) const {
+        wb.put(key_at(height), encode());
+    }
+
+    template<typename D>
+    static std::optional<StateDigest> at(D& status, uint64_t height) {
+        std::optional<std::vector<uint8_t>> value = status.get(key_at(height));
+        if (!value.has_value() || value->size() != 32) {
+            return std::nullopt;
+        }
+        StateDigest digest;
+        std::memcpy(digest.acc.data(), value->data(), 32);
+        return digest;
+    }
+
+    bool operator==(const StateDigest& other) const {
+        return acc == other.acc;
+    }
+
+    bool operator!=(const StateDigest& other) const {
+        return acc != other.acc;
+    }
+
+private:
+    // Little endian 256-bit accumulator.
+    std::array<uint64_t, 4> acc;
+
+    void fold(DigestOp op, const std::string& table, const std::string& key, const std::string& value, bool add) {
+        std::string element(1, static_cast<char>(op));
+        put_varint(element, table.size());
+        element += table;
+        put_varint(element, key.size());
+        element += key;
+        element += value;
+        libbitcoin::system::hash_digest hash = libbitcoin::system::sha256_hash(libbitcoin::system::data_chunk(element.begin(), element.end()));
+        std::array<uint64_t, 4> limbs;
+        std::memcpy(limbs.data(), hash.data(), 32);
+
+        unsigned __int128 carry = 0;
+        for (size_t i = 0; i < 4; i++) {
+            unsigned __int128 sum = add
+                ? static_cast<unsigned __int128>(acc[i]) + limbs[i] + carry
+                : static_cast<unsigned __int128>(acc[i]) + ~limbs[i] + (i == 0 ? 1 : 0) + carry;
+            acc[i] = static_cast<uint64_t>(sum);
+            carry = sum >> 64;
+        }
+    }
+};
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <vector>
+#include <optional>
+#include <cstdint>
+
+// Parsed inscription types, kept apart from the envelope parser in
+// inscription.h so code that only passes inscriptions around (the mempool
+// follower and its fixture test) does not need the script machinery.
+//
+// Callers get a transaction's inscriptions through an unqualified
+// inscriptions_of(tx) call, so argument-dependent lookup picks the overload
+// for the tx type: inscription.h defines it for Tx, fixtures define their own.
+
+struct Inscription {
+    std::optional<std::vector<uint8_t>> body;
+    std::optional<std::vector<uint8_t>> content_type;
+};
+
+struct TransactionInscription {
+    Inscription inscription;
+    uint32_t tx_in_index;
+    uint32_t tx_in_offset;
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <stdexcept>
+
+// LEB128 varints used by the snapshot and history encodings.
+inline void put_varint(std::string& out, uint64_t n) {
+    while (n >= 0x80) {
+        out.push_back(static_cast<char>((n & 0x7f) | 0x80));
+        n >>= 7;
+    }
+    out.push_back(static_cast<char>(n));
+}
+
+inline uint64_t get_varint(const char* in, size_t size, size_t& pos) {
+    uint64_t n = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (pos >= size) {
+            throw std::runtime_error("truncated varint");
+        }
+        uint8_t byte = static_cast<uint8_t>(in[pos++]);
+        n |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return n;
+        }
+    }
+    throw std::runtime_error("varint too long");
+}
+
+inline uint64_t get_varint(const std::string& in, size_t& pos) {
+    return get_varint(in.data(), in.size(), pos);
+}